@@ -0,0 +1,40 @@
+/* histodog: incoming pitches, and queries of the running histograms */
+
+#include <stdlib.h>
+#include "../histodog/histodog.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NPIT 4096       /* table of random pitches, used cyclically */
+#define NFLOAT 1000000
+#define NWTF 100000
+
+static void bench_histofloat(char *name, t_float *pitches, t_float decay)
+{
+    t_histodog *x = (t_histodog *)histodog_new(1000, decay);
+    int i;
+    bench_begin();
+    for (i = 0; i < NFLOAT; i++)
+        histodog_float(x, pitches[i % NPIT]);
+    bench_end(name, NFLOAT);
+    if (decay == 0)
+    {
+        bench_begin();
+        for (i = 0; i < NWTF; i++)
+            histodog_wtf(x, 500, 1, 10, 0.05);
+        bench_end("histodog-wtf", NWTF);
+    }
+    pd_free(&x->x_obj.ob_pd);
+}
+
+void bench_histodog(void)
+{
+    static t_float pitches[NPIT];
+    int i;
+    srandom(1);
+    histodog_setup();
+    for (i = 0; i < NPIT; i++)
+        pitches[i] = 40 + 50 * (random() / (float)RAND_MAX);
+    bench_histofloat("histodog-float", pitches, 0);
+    bench_histofloat("histodog-float-decay", pitches, 0.999);
+}
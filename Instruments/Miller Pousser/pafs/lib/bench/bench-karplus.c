@@ -0,0 +1,44 @@
+/* karplus~: banks of 8 and 64 strings, replucked every so often */
+
+#include "../karplus~/karplus~.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NTICK 20000
+#define BLOCKSIZE 64
+#define PLUCKEVERY 50   /* blocks between plucks of each string */
+
+static void bench_bank(char *name, int nstrings)
+{
+    t_karplus_tilde *x = (t_karplus_tilde *)karplus_tilde_new(nstrings, 20);
+    t_signal *sigs[2];
+    t_atom av[3];
+    int i, j;
+    sigs[0] = pdhost_signal_new(BLOCKSIZE);
+    sigs[1] = pdhost_signal_new(BLOCKSIZE);
+    karplus_tilde_dsp(x, sigs);
+    bench_begin();
+    for (i = 0; i < NTICK; i++)
+    {
+        for (j = i % PLUCKEVERY; j < nstrings; j += PLUCKEVERY)
+        {
+            SETFLOAT(&av[0], j + 1);
+            SETFLOAT(&av[1], 55 * (1 + j % 24));
+            SETFLOAT(&av[2], 0.5);
+            karplus_tilde_pluck(x, 0, 3, av);
+        }
+        pdhost_dsp_tick();
+    }
+    bench_end(name, (long)NTICK * nstrings);
+    pdhost_dsp_clear();
+    pd_free(&x->x_obj.ob_pd);
+    pdhost_signal_free(sigs[0]);
+    pdhost_signal_free(sigs[1]);
+}
+
+void bench_karplus(void)
+{
+    karplus_tilde_setup();
+    bench_bank("karplus~-8strings", 8);
+    bench_bank("karplus~-64strings", 64);
+}
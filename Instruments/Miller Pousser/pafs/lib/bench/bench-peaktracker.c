@@ -0,0 +1,44 @@
+/* peaktracker: frames of partials matched with "doit" and "snapshot" */
+
+#include <stdlib.h>
+#include "../peaktracker/peaktracker.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NVARY 64        /* frames of frequency variation, used cyclically */
+
+static void bench_peakframes(char *name, int npartial, int nframe,
+    int snapshot)
+{
+    t_peaktracker *x = (t_peaktracker *)peaktracker_new(&s_, npartial);
+    float vary[NVARY];
+    int i, frame;
+    for (i = 0; i < NVARY; i++)
+        vary[i] = 1 + 0.01 * (random() / (float)RAND_MAX - 0.5);
+    if (snapshot)
+    {
+        peaktracker_inter1value(x, 3);
+        peaktracker_inter1halftones(x, 12);
+    }
+    bench_begin();
+    for (frame = 0; frame < nframe; frame++)
+    {
+        for (i = 0; i < npartial; i++)
+            peaktracker_peakin(x, 110 * (i+1) * vary[(frame + i) % NVARY],
+                1. / (i+1));
+        if (snapshot)
+            peaktracker_start(x);
+        else peaktracker_doit(x);
+    }
+    bench_end(name, nframe);
+    pd_free(&x->x_ob.ob_pd);
+}
+
+void bench_peaktracker(void)
+{
+    srandom(1);
+    peaktracker_setup();
+    bench_peakframes("peaktracker-doit-10", 10, 1000000, 0);
+    bench_peakframes("peaktracker-doit-100", 100, 50000, 0);
+    bench_peakframes("peaktracker-snapshot-100", 100, 50000, 1);
+}
@@ -0,0 +1,74 @@
+/* pitchcenter: snapping pitches to a set, directly and octave-folded;
+and pitchcenter~, snapping a block of them at a time */
+
+#include <string.h>
+#include "../pitchcenter/pitchcenter.c"
+#include "../pitchcenter~/pitchcenter~.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NPIT 4096       /* table of random pitches, used cyclically */
+#define NFLOAT 1000000
+#define NTICK 20000
+#define BLOCKSIZE 64
+
+void bench_pitchcenter(void)
+{
+    static t_float pitches[NPIT];
+    static int scale[] = {0, 2, 4, 5, 7, 9, 11};
+    t_atom set[7 * 8];
+    t_pitchcenter *x;
+    int i, fold;
+    srandom(1);
+    pitchcenter_setup();
+    for (i = 0; i < NPIT; i++)
+        pitches[i] = 24 + 84 * (random() / (float)RAND_MAX);
+    for (i = 0; i < 7 * 8; i++)
+        SETFLOAT(&set[i], 12 * (i/7 + 1) + scale[i % 7]);
+    for (fold = 0; fold < 2; fold++)
+    {
+        x = (t_pitchcenter *)pitchcenter_new();
+        pitchcenter_fold(x, fold);
+        pitchcenter_set(x, &s_, (fold ? 7 : 7 * 8), set);
+        bench_begin();
+        for (i = 0; i < NFLOAT; i++)
+            pitchcenter_float(x, pitches[i % NPIT]);
+        bench_end((fold ? "pitchcenter-fold" : "pitchcenter"), NFLOAT);
+        pd_free(&x->x_obj.ob_pd);
+    }
+}
+
+void bench_pitchcenter_tilde(void)
+{
+    static t_float pitches[NPIT];
+    static int scale[] = {0, 2, 4, 5, 7, 9, 11};
+    t_atom set[7 * 8];
+    t_pitchcenter_tilde *x;
+    t_signal *sigs[2];
+    int i;
+    srandom(1);
+    pitchcenter_tilde_setup();
+    for (i = 0; i < NPIT; i++)
+        pitches[i] = 24 + 84 * (random() / (float)RAND_MAX);
+    for (i = 0; i < 7 * 8; i++)
+        SETFLOAT(&set[i], 12 * (i/7 + 1) + scale[i % 7]);
+    x = (t_pitchcenter_tilde *)pitchcenter_tilde_new(0.25);
+    pitchcenter_tilde_set(x, &s_, 7 * 8, set);
+    sigs[0] = pdhost_signal_new(BLOCKSIZE);
+    sigs[1] = pdhost_signal_new(BLOCKSIZE);
+    pitchcenter_tilde_dsp(x, sigs);
+    bench_begin();
+    for (i = 0; i < NTICK; i++)
+    {
+            /* a new stretch of the table each time (NPIT is a multiple
+            of BLOCKSIZE) */
+        memcpy(sigs[0]->s_vec, pitches + (i * BLOCKSIZE) % NPIT,
+            BLOCKSIZE * sizeof(t_float));
+        pdhost_dsp_tick();
+    }
+    bench_end("pitchcenter~-block64", (long)NTICK * BLOCKSIZE);
+    pdhost_dsp_clear();
+    pd_free(&x->x_obj.ob_pd);
+    pdhost_signal_free(sigs[0]);
+    pdhost_signal_free(sigs[1]);
+}
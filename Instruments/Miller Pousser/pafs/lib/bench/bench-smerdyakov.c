@@ -0,0 +1,22 @@
+/* smerdyakov: playback ticks on a sequence from the walk corpus */
+
+#include "../smerdyakov/smerdyakov.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NTICK 1000000
+
+void bench_smerdyakov(void)
+{
+    t_smerdyakov *x;
+    int n;
+    smerdyakov_setup();
+    x = (t_smerdyakov *)smerdyakov_new(&s_, 128, 4);
+    smerdyakov_read(x, gensym("walk0.txt"), &s_);
+    smerdyakov_play(x, 1);
+    bench_begin();
+    n = pdhost_runclocks(1e300, NTICK);
+    bench_end("smerdyakov-tick-walk0", n);
+    smerdyakov_play(x, 0);
+    pd_free(&x->x_ob.ob_pd);
+}
@@ -0,0 +1,47 @@
+/* tabreadwrap4~: many voices reading one multi-segment table */
+
+#include <math.h>
+#include "../tabreadwrap4~/tabreadwrap4~.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NVOICE 1000
+#define NTICK 1000
+#define BLOCKSIZE 64
+#define WRAP 1024
+#define NSEG 16
+
+void bench_tabreadwrap4(void)
+{
+    static t_tabreadwrap4_tilde *voices[NVOICE];
+    static t_signal *sigs[NVOICE][3];
+    t_word *vec = pdhost_array_new("bench-wrap", WRAP * NSEG);
+    int i, j;
+    tabreadwrap4_tilde_setup();
+    for (i = 0; i < WRAP * NSEG; i++)
+        vec[i].w_float = sin(2 * 3.14159265 * (1 + i/WRAP) * i / WRAP);
+    for (i = 0; i < NVOICE; i++)
+    {
+        voices[i] = (t_tabreadwrap4_tilde *)tabreadwrap4_tilde_new(
+            gensym("bench-wrap"), WRAP, 0);
+        for (j = 0; j < 3; j++)
+            sigs[i][j] = pdhost_signal_new(BLOCKSIZE);
+        for (j = 0; j < BLOCKSIZE; j++)
+        {
+            sigs[i][0]->s_vec[j] = (i + j) * (1./BLOCKSIZE);
+            sigs[i][1]->s_vec[j] = (i % (NSEG-1)) + j * (1./BLOCKSIZE);
+        }
+        tabreadwrap4_tilde_dsp(voices[i], sigs[i]);
+    }
+    bench_begin();
+    for (i = 0; i < NTICK; i++)
+        pdhost_dsp_tick();
+    bench_end("tabreadwrap4~-block64", (long)NTICK * NVOICE);
+    pdhost_dsp_clear();
+    for (i = 0; i < NVOICE; i++)
+    {
+        pd_free(&voices[i]->x_obj.ob_pd);
+        for (j = 0; j < 3; j++)
+            pdhost_signal_free(sigs[i][j]);
+    }
+}
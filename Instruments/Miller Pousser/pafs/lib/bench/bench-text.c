@@ -0,0 +1,41 @@
+/* text: sequenced playback of a million messages */
+
+#include "../text/text.c"
+#include "pdhost.h"
+#include "bench.h"
+
+#define NMESS 1000000
+
+static void bench_playback(char *name, t_atom *av, int absolute)
+{
+    t_txt *x = (t_txt *)txt_new();
+    long nmess = pdhost_nmess;
+    txt_set(x, &s_, 4 * NMESS, av);
+    txt_absolute(x, absolute);
+    bench_begin();
+    txt_start(x);
+    pdhost_runclocks(1e300, 0x7fffffff);
+    bench_end(name, pdhost_nmess - nmess);
+    pd_free(&x->x_ob.ob_pd);
+}
+
+void bench_text(void)
+{
+    t_atom *av = (t_atom *)getbytes(4 * NMESS * sizeof(t_atom)), *ap;
+    t_pd *sink = pdhost_sink_new("bench-sink");
+    t_symbol *target = gensym("bench-sink");
+    int i;
+    text_setup();
+    for (i = 0, ap = av; i < NMESS; i++, ap += 4)
+    {
+        SETFLOAT(ap, 1);
+        SETSYMBOL(ap+1, target);
+        SETFLOAT(ap+2, i);
+        SETSEMI(ap+3);
+    }
+    bench_playback("text-playback", av, 0);
+    bench_playback("text-playback-absolute", av, 1);
+    freebytes(av, 4 * NMESS * sizeof(t_atom));
+    pd_unbind(sink, target);
+    pd_free(sink);
+}
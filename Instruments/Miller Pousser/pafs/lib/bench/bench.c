@@ -0,0 +1,126 @@
+/* Headless benchmarks for the externals in this library.  Each scenario
+makes objects with the host shim in pdhost.c, calls their methods directly
+and runs their clocks or DSP chain, and prints one line per measurement:
+
+    name    ops     ns/op   allocs/op
+
+separated by tabs, with a header line beginning with "#", so that runs can
+be compared by a script.  Allocations are calls to getbytes(),
+resizebytes() and so on, including those Pd itself would make on the
+objects' behalf (binbufs, for instance).
+
+usage: bench [-d libdir] [-v] [scenario ...]
+
+where libdir (default "..") is where the data files such as walk0.txt are,
+-v prints the objects' posts and errors, and the scenarios, if given, are
+names (or prefixes of names) from the list below.  A first "#" line says
+which DSP kernels were chosen (see ../cpu/cpu.h); set PAFS_CPU to compare
+them. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "m_pd.h"
+#include "pdhost.h"
+#include "bench.h"
+#include "../cpu/cpu.h"
+
+void bench_smerdyakov(void);
+void bench_peaktracker(void);
+void bench_tabreadwrap4(void);
+void bench_text(void);
+void bench_histodog(void);
+void bench_pitchcenter(void);
+void bench_pitchcenter_tilde(void);
+void bench_karplus(void);
+
+static struct
+{
+    char *s_name;
+    void (*s_fn)(void);
+} scenarios[] =
+{
+    {"smerdyakov", bench_smerdyakov},
+    {"peaktracker", bench_peaktracker},
+    {"tabreadwrap4~", bench_tabreadwrap4},
+    {"text", bench_text},
+    {"histodog", bench_histodog},
+    {"pitchcenter", bench_pitchcenter},
+    {"pitchcenter~", bench_pitchcenter_tilde},
+    {"karplus~", bench_karplus},
+};
+#define NSCENARIO (sizeof(scenarios)/sizeof(scenarios[0]))
+
+char *bench_dir = "..";
+static struct timespec bench_starttime;
+static long bench_startalloc;
+
+void bench_begin(void)
+{
+    bench_startalloc = pdhost_nalloc;
+    clock_gettime(CLOCK_MONOTONIC, &bench_starttime);
+}
+
+void bench_end(char *name, long nops)
+{
+    struct timespec now;
+    double ns;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (now.tv_sec - bench_starttime.tv_sec) * 1e9 +
+        (now.tv_nsec - bench_starttime.tv_nsec);
+    if (nops < 1)
+        nops = 1;
+    printf("%s\t%ld\t%.1f\t%.3f\n", name, nops, ns / nops,
+        (pdhost_nalloc - bench_startalloc) / (double)nops);
+    fflush(stdout);
+}
+
+static void usage(void)
+{
+    unsigned int i;
+    fprintf(stderr, "usage: bench [-d libdir] [-v] [scenario ...]\n");
+    fprintf(stderr, "scenarios:");
+    for (i = 0; i < NSCENARIO; i++)
+        fprintf(stderr, " %s", scenarios[i].s_name);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int ch, j;
+    while ((ch = getopt(argc, argv, "d:v")) != -1)
+        switch (ch)
+    {
+    case 'd': bench_dir = optarg; break;
+    case 'v': pdhost_verbose = 1; break;
+    default: usage();
+    }
+    for (j = optind; j < argc; j++)
+    {
+        for (i = 0; i < NSCENARIO; i++)
+            if (!strncmp(scenarios[i].s_name, argv[j], strlen(argv[j])))
+                break;
+        if (i == NSCENARIO)
+            usage();
+    }
+    pdhost_setdir(bench_dir);
+    printf("# kernels: %s\n", cpu_levelname(cpu_level()));
+    printf("# name\tops\tns/op\tallocs/op\n");
+    for (i = 0; i < NSCENARIO; i++)
+    {
+        if (optind < argc)
+        {
+            for (j = optind; j < argc; j++)
+                if (!strncmp(scenarios[i].s_name, argv[j], strlen(argv[j])))
+                    break;
+            if (j == argc)
+                continue;
+        }
+        (*scenarios[i].s_fn)();
+    }
+    return (0);
+}
@@ -0,0 +1,6 @@
+/* shared by the benchmark scenarios -- see bench.c */
+
+extern char *bench_dir;                 /* the library directory */
+
+void bench_begin(void);                 /* start timing and counting */
+void bench_end(char *name, long nops);  /* stop and report one line */
@@ -0,0 +1,1019 @@
+/* pdhost -- the part of Pd's API the externals in this library use, enough
+to make and drive them in an ordinary program.  Messages aren't dispatched
+through method tables; the benchmarks call the objects' methods directly
+and the host only counts and hashes what comes back out.  Everything but
+the classes is kept per thread (see pdhost.h). */
+
+    /* Pd has added "const" to many of these prototypes over the years.  So
+    that this file compiles against any version of m_pd.h, the functions it
+    defines are renamed while the header is read, and defined below with
+    their own prototypes; the linker only sees the names. */
+#define gensym pdhost_decl_gensym
+#define copybytes pdhost_decl_copybytes
+#define post pdhost_decl_post
+#define startpost pdhost_decl_startpost
+#define poststring pdhost_decl_poststring
+#define endpost pdhost_decl_endpost
+#define error pdhost_decl_error
+#define bug pdhost_decl_bug
+#define pd_error pdhost_decl_pd_error
+#define sys_vgui pdhost_decl_sys_vgui
+#define sys_gui pdhost_decl_sys_gui
+#define atom_string pdhost_decl_atom_string
+#define atom_getfloat pdhost_decl_atom_getfloat
+#define atom_getsymbol pdhost_decl_atom_getsymbol
+#define atom_getfloatarg pdhost_decl_atom_getfloatarg
+#define atom_getsymbolarg pdhost_decl_atom_getsymbolarg
+#define binbuf_text pdhost_decl_binbuf_text
+#define binbuf_add pdhost_decl_binbuf_add
+#define binbuf_addv pdhost_decl_binbuf_addv
+#define binbuf_addbinbuf pdhost_decl_binbuf_addbinbuf
+#define binbuf_getnatom pdhost_decl_binbuf_getnatom
+#define binbuf_getvec pdhost_decl_binbuf_getvec
+#define binbuf_print pdhost_decl_binbuf_print
+#define binbuf_read_via_canvas pdhost_decl_binbuf_read_via_canvas
+#define binbuf_write pdhost_decl_binbuf_write
+#define canvas_makefilename pdhost_decl_canvas_makefilename
+#define canvas_getdir pdhost_decl_canvas_getdir
+#define open_via_path pdhost_decl_open_via_path
+#define sys_bashfilename pdhost_decl_sys_bashfilename
+#define class_gethelpdir pdhost_decl_class_gethelpdir
+#define class_getname pdhost_decl_class_getname
+#define pd_findbyclass pdhost_decl_pd_findbyclass
+#include "m_pd.h"
+#undef gensym
+#undef copybytes
+#undef post
+#undef startpost
+#undef poststring
+#undef endpost
+#undef error
+#undef bug
+#undef pd_error
+#undef sys_vgui
+#undef sys_gui
+#undef atom_string
+#undef atom_getfloat
+#undef atom_getsymbol
+#undef atom_getfloatarg
+#undef atom_getsymbolarg
+#undef binbuf_text
+#undef binbuf_add
+#undef binbuf_addv
+#undef binbuf_addbinbuf
+#undef binbuf_getnatom
+#undef binbuf_getvec
+#undef binbuf_print
+#undef binbuf_read_via_canvas
+#undef binbuf_write
+#undef canvas_makefilename
+#undef canvas_getdir
+#undef open_via_path
+#undef sys_bashfilename
+#undef class_gethelpdir
+#undef class_getname
+#undef pd_findbyclass
+    /* and these are macros in m_pd.h */
+#undef class_addbang
+#undef class_addpointer
+#undef class_addsymbol
+#undef class_addlist
+#undef class_addanything
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pdhost.h"
+
+PDHOST_PERTHREAD long pdhost_nalloc, pdhost_nout, pdhost_nmess, pdhost_ngui,
+    pdhost_npost;
+PDHOST_PERTHREAD unsigned long pdhost_outhash;
+int pdhost_verbose, pdhost_hashout;
+static pthread_mutex_t pdhost_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void pdhost_resetcounts(void)
+{
+    pdhost_nalloc = pdhost_nout = pdhost_nmess = pdhost_ngui =
+        pdhost_npost = 0;
+    pdhost_outhash = 0;
+}
+
+    /* numbered rather than, say, the address of a thread-local variable,
+    which a later thread can get again */
+void *pdhost_instance(void)
+{
+    static long count;
+    static PDHOST_PERTHREAD long number;
+    if (!number)
+    {
+        pthread_mutex_lock(&pdhost_mutex);
+        number = ++count;
+        pthread_mutex_unlock(&pdhost_mutex);
+    }
+    return ((void *)number);
+}
+
+/* ------------------------- memory ----------------------------- */
+
+void *getbytes(size_t nbytes)
+{
+    void *ret = calloc(nbytes ? nbytes : 1, 1);
+    if (!ret)
+    {
+        fprintf(stderr, "pdhost: out of memory\n");
+        exit(1);
+    }
+    pdhost_nalloc++;
+    return (ret);
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+    free(x);
+}
+
+void *resizebytes(void *old, size_t oldsize, size_t newsize)
+{
+    char *ret = realloc(old, newsize ? newsize : 1);
+    if (!ret)
+    {
+        fprintf(stderr, "pdhost: out of memory\n");
+        exit(1);
+    }
+    if (newsize > oldsize)
+        memset(ret + oldsize, 0, newsize - oldsize);
+    pdhost_nalloc++;
+    return (ret);
+}
+
+void *copybytes(const void *src, size_t nbytes)
+{
+    void *ret = getbytes(nbytes);
+    memcpy(ret, src, nbytes);
+    return (ret);
+}
+
+/* ------------------------- printing ----------------------------- */
+
+static void pdhost_vpost(const char *prefix, const char *fmt, va_list ap)
+{
+    pdhost_npost++;
+    if (pdhost_verbose)
+    {
+        fputs(prefix, stderr);
+        vfprintf(stderr, fmt, ap);
+        putc('\n', stderr);
+    }
+}
+
+void post(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdhost_vpost("", fmt, ap);
+    va_end(ap);
+}
+
+void startpost(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdhost_vpost("", fmt, ap);
+    va_end(ap);
+}
+
+void poststring(const char *s)
+{
+    post(" %s", s);
+}
+
+void endpost(void)
+{
+}
+
+void error(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdhost_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+void bug(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdhost_vpost("consistency check failed: ", fmt, ap);
+    va_end(ap);
+}
+
+void pd_error(const void *object, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    pdhost_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+void sys_gui(const char *s)
+{
+    pdhost_ngui++;
+}
+
+void sys_vgui(const char *fmt, ...)
+{
+    pdhost_ngui++;
+}
+
+/* ------------------------- symbols ----------------------------- */
+
+#define HASHSIZE 1024
+
+t_symbol s_pointer = {"pointer", 0, 0};
+t_symbol s_float = {"float", 0, 0};
+t_symbol s_symbol = {"symbol", 0, 0};
+t_symbol s_bang = {"bang", 0, 0};
+t_symbol s_list = {"list", 0, 0};
+t_symbol s_anything = {"anything", 0, 0};
+t_symbol s_signal = {"signal", 0, 0};
+t_symbol s__N = {"#N", 0, 0};
+t_symbol s__X = {"#X", 0, 0};
+t_symbol s_x = {"x", 0, 0};
+t_symbol s_y = {"y", 0, 0};
+t_symbol s_ = {"", 0, 0};
+
+    /* the built-in symbols are shared by all threads, so they aren't in
+    the (per-thread) hash table, whose chains run through s_next */
+static t_symbol *builtins[] = {&s_pointer, &s_float, &s_symbol, &s_bang,
+    &s_list, &s_anything, &s_signal, &s__N, &s__X, &s_x, &s_y, &s_};
+
+static PDHOST_PERTHREAD t_symbol *symhash[HASHSIZE];
+
+static int pdhost_hash(const char *s)
+{
+    unsigned int hash = 5381;
+    while (*s)
+        hash = hash * 33 + (unsigned char)*s++;
+    return (hash & (HASHSIZE - 1));
+}
+
+static void pdhost_addsym(t_symbol *sym)
+{
+    int h = pdhost_hash(sym->s_name);
+    sym->s_next = symhash[h];
+    symhash[h] = sym;
+}
+
+t_symbol *gensym(const char *s)
+{
+    t_symbol *sym;
+    int i;
+    for (sym = symhash[pdhost_hash(s)]; sym; sym = sym->s_next)
+        if (!strcmp(sym->s_name, s))
+            return (sym);
+    for (i = 0; i < (int)(sizeof(builtins)/sizeof(*builtins)); i++)
+        if (!strcmp(builtins[i]->s_name, s))
+            return (builtins[i]);
+    sym = (t_symbol *)getbytes(sizeof(*sym));
+    sym->s_name = strcpy((char *)getbytes(strlen(s) + 1), s);
+    sym->s_thing = 0;
+    pdhost_addsym(sym);
+    return (sym);
+}
+
+/* ------------------------- atoms ----------------------------- */
+
+t_float atom_getfloat(const t_atom *a)
+{
+    return (a->a_type == A_FLOAT ? a->a_w.w_float : 0);
+}
+
+t_symbol *atom_getsymbol(const t_atom *a)
+{
+    return (a->a_type == A_SYMBOL ? a->a_w.w_symbol : &s_);
+}
+
+t_float atom_getfloatarg(int which, int argc, const t_atom *argv)
+{
+    return (which < argc ? atom_getfloat(argv + which) : 0);
+}
+
+t_symbol *atom_getsymbolarg(int which, int argc, const t_atom *argv)
+{
+    return (which < argc ? atom_getsymbol(argv + which) : &s_);
+}
+
+void atom_string(const t_atom *a, char *buf, unsigned int bufsize)
+{
+    switch (a->a_type)
+    {
+    case A_SEMI: snprintf(buf, bufsize, ";"); break;
+    case A_COMMA: snprintf(buf, bufsize, ","); break;
+    case A_FLOAT: snprintf(buf, bufsize, "%g", a->a_w.w_float); break;
+    case A_SYMBOL:
+        snprintf(buf, bufsize, "%s", a->a_w.w_symbol->s_name); break;
+    case A_DOLLAR: snprintf(buf, bufsize, "$%d", a->a_w.w_index); break;
+    default: snprintf(buf, bufsize, "???");
+    }
+}
+
+/* ------------------------- binbufs ----------------------------- */
+
+struct _binbuf
+{
+    int b_n;
+    t_atom *b_vec;
+};
+
+t_binbuf *binbuf_new(void)
+{
+    t_binbuf *x = (t_binbuf *)getbytes(sizeof(*x));
+    x->b_n = 0;
+    x->b_vec = (t_atom *)getbytes(0);
+    return (x);
+}
+
+void binbuf_free(t_binbuf *x)
+{
+    freebytes(x->b_vec, x->b_n * sizeof(t_atom));
+    freebytes(x, sizeof(*x));
+}
+
+void binbuf_clear(t_binbuf *x)
+{
+    x->b_vec = (t_atom *)resizebytes(x->b_vec, x->b_n * sizeof(t_atom), 0);
+    x->b_n = 0;
+}
+
+    /* like Pd's, this reallocates on every call */
+void binbuf_add(t_binbuf *x, int argc, const t_atom *argv)
+{
+    x->b_vec = (t_atom *)resizebytes(x->b_vec, x->b_n * sizeof(t_atom),
+        (x->b_n + argc) * sizeof(t_atom));
+    memcpy(x->b_vec + x->b_n, argv, argc * sizeof(t_atom));
+    x->b_n += argc;
+}
+
+void binbuf_addsemi(t_binbuf *x)
+{
+    t_atom a;
+    SETSEMI(&a);
+    binbuf_add(x, 1, &a);
+}
+
+void binbuf_addbinbuf(t_binbuf *x, const t_binbuf *y)
+{
+    binbuf_add(x, y->b_n, y->b_vec);
+}
+
+void binbuf_addv(t_binbuf *x, const char *fmt, ...)
+{
+    va_list ap;
+    t_atom a;
+    va_start(ap, fmt);
+    for (; *fmt; fmt++)
+    {
+        switch (*fmt)
+        {
+        case 'i': SETFLOAT(&a, va_arg(ap, int)); break;
+        case 'f': SETFLOAT(&a, va_arg(ap, double)); break;
+        case 's': SETSYMBOL(&a, va_arg(ap, t_symbol *)); break;
+        case ';': SETSEMI(&a); break;
+        case ',': SETCOMMA(&a); break;
+        default: continue;
+        }
+        binbuf_add(x, 1, &a);
+    }
+    va_end(ap);
+}
+
+int binbuf_getnatom(const t_binbuf *x)
+{
+    return (x->b_n);
+}
+
+t_atom *binbuf_getvec(const t_binbuf *x)
+{
+    return (x->b_vec);
+}
+
+    /* parse text into atoms: numbers, symbols (with backslash escapes),
+    semicolons and commas.  Dollar signs aren't interpreted. */
+void binbuf_text(t_binbuf *x, const char *text, size_t size)
+{
+    const char *s = text, *end = text + size;
+    char buf[MAXPDSTRING];
+    binbuf_clear(x);
+    while (1)
+    {
+        t_atom a;
+        int n = 0;
+        while (s < end && isspace((unsigned char)*s))
+            s++;
+        if (s >= end)
+            break;
+        if (*s == ';')
+            SETSEMI(&a), s++;
+        else if (*s == ',')
+            SETCOMMA(&a), s++;
+        else
+        {
+            char *e;
+            double f;
+            while (s < end && !isspace((unsigned char)*s) && *s != ';' &&
+                *s != ',')
+            {
+                if (*s == '\\' && s + 1 < end)
+                    s++;
+                if (n < MAXPDSTRING-1)
+                    buf[n++] = *s;
+                s++;
+            }
+            buf[n] = 0;
+            f = strtod(buf, &e);
+            if (!*e)
+                SETFLOAT(&a, f);
+            else SETSYMBOL(&a, gensym(buf));
+        }
+        binbuf_add(x, 1, &a);
+    }
+}
+
+void binbuf_print(const t_binbuf *x)
+{
+    char buf[MAXPDSTRING];
+    int i;
+    for (i = 0; i < x->b_n; i++)
+    {
+        atom_string(&x->b_vec[i], buf, MAXPDSTRING);
+        post("%s", buf);
+    }
+}
+
+/* ------------------------- files ----------------------------- */
+
+static char pdhost_dir[MAXPDSTRING] = ".";
+
+void pdhost_setdir(char *dir)
+{
+    snprintf(pdhost_dir, MAXPDSTRING, "%s", dir);
+}
+
+t_canvas *canvas_getcurrent(void)
+{
+    static double canvas[64];   /* never looked inside */
+    return ((t_canvas *)canvas);
+}
+
+t_symbol *canvas_getdir(const t_canvas *x)
+{
+    return (gensym(pdhost_dir));
+}
+
+void canvas_makefilename(const t_canvas *c, const char *file, char *result,
+    int resultsize)
+{
+    if (file[0] == '/')
+        snprintf(result, resultsize, "%s", file);
+    else snprintf(result, resultsize, "%s/%s", pdhost_dir, file);
+}
+
+void sys_bashfilename(const char *from, char *to)
+{
+    if (from != to)
+        memmove(to, from, strlen(from) + 1);
+}
+
+int open_via_path(const char *dir, const char *name, const char *ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin)
+{
+    char *slash;
+    int fd;
+    if (name[0] == '/')
+        snprintf(dirresult, size, "%s%s", name, ext);
+    else snprintf(dirresult, size, "%s/%s%s", dir, name, ext);
+    if ((fd = open(dirresult, O_RDONLY)) < 0)
+        return (-1);
+    slash = strrchr(dirresult, '/');
+    *slash = 0;
+    *nameresult = slash + 1;
+    return (fd);
+}
+
+int binbuf_read_via_canvas(t_binbuf *b, const char *filename,
+    const t_canvas *canvas, int crflag)
+{
+    char path[MAXPDSTRING], *buf;
+    FILE *fd;
+    long length, i;
+    canvas_makefilename(canvas, filename, path, MAXPDSTRING);
+    if (!(fd = fopen(path, "r")))
+        return (1);
+    fseek(fd, 0, SEEK_END);
+    length = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    buf = (char *)getbytes(length + 1);
+    length = fread(buf, 1, length, fd);
+    fclose(fd);
+    if (crflag)
+        for (i = 0; i < length; i++)
+            if (buf[i] == '\n')
+                buf[i] = ';';
+    binbuf_text(b, buf, length);
+    freebytes(buf, length + 1);
+    return (0);
+}
+
+int binbuf_write(const t_binbuf *x, const char *filename, const char *dir,
+    int crflag)
+{
+    char path[MAXPDSTRING], buf[MAXPDSTRING];
+    FILE *fd;
+    int i;
+    if (*dir && filename[0] != '/')
+        snprintf(path, MAXPDSTRING, "%s/%s", dir, filename);
+    else snprintf(path, MAXPDSTRING, "%s", filename);
+    if (!(fd = fopen(path, "w")))
+        return (1);
+    for (i = 0; i < x->b_n; i++)
+    {
+        t_atom *ap = &x->b_vec[i];
+        if (ap->a_type == A_SEMI)
+            fputs(crflag ? "\n" : ";\n", fd);
+        else
+        {
+            atom_string(ap, buf, MAXPDSTRING);
+            fprintf(fd, "%s ", buf);
+        }
+    }
+    return (fclose(fd) != 0);
+}
+
+/* ------------------------- classes and objects ---------------------- */
+
+struct _class
+{
+    t_symbol *c_name;
+    size_t c_size;
+    t_method c_freemethod;
+    int c_patchable;
+};
+
+t_class *garray_class;
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod, t_method freemethod,
+    size_t size, int flags, t_atomtype arg1, ...)
+{
+    t_class *c = (t_class *)getbytes(sizeof(*c));
+    c->c_name = name;
+    c->c_size = size;
+    c->c_freemethod = freemethod;
+    c->c_patchable = ((flags & 3) != CLASS_PD && (flags & 3) != CLASS_GOBJ);
+    return (c);
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel,
+    t_atomtype arg1, ...)
+{
+}
+
+void class_addbang(t_class *c, t_method fn) {}
+void class_addpointer(t_class *c, t_method fn) {}
+void class_doaddfloat(t_class *c, t_method fn) {}
+void class_addsymbol(t_class *c, t_method fn) {}
+void class_addlist(t_class *c, t_method fn) {}
+void class_addanything(t_class *c, t_method fn) {}
+void class_setsavefn(t_class *c, t_savefn f) {}
+void class_domainsignalin(t_class *c, int onset) {}
+
+const char *class_getname(const t_class *c)
+{
+    return (c->c_name->s_name);
+}
+
+const char *class_gethelpdir(const t_class *c)
+{
+    return (pdhost_dir);
+}
+
+struct _outlet
+{
+    struct _outlet *o_next;
+};
+
+t_pd *pd_new(t_class *c)
+{
+    t_pd *x = (t_pd *)getbytes(c->c_size);
+    *x = c;
+    return (x);
+}
+
+void pd_free(t_pd *x)
+{
+    t_class *c = *x;
+    if (c->c_freemethod)
+        (*(void (*)(t_pd *))c->c_freemethod)(x);
+    if (c->c_patchable)
+    {
+        t_outlet *o = ((t_object *)x)->ob_outlet, *next;
+        for (; o; o = next)
+            next = o->o_next, freebytes(o, sizeof(*o));
+    }
+    freebytes(x, c->c_size);
+}
+
+    /* bindings are kept in one list; s_thing points to the most recent
+    object bound to a symbol, rather than a bindlist as in Pd */
+typedef struct _binding
+{
+    t_symbol *b_sym;
+    t_pd *b_pd;
+    struct _binding *b_next;
+} t_binding;
+
+static PDHOST_PERTHREAD t_binding *pdhost_bindings;
+
+void pd_bind(t_pd *x, t_symbol *s)
+{
+    t_binding *b = (t_binding *)getbytes(sizeof(*b));
+    b->b_sym = s;
+    b->b_pd = x;
+    b->b_next = pdhost_bindings;
+    pdhost_bindings = b;
+    s->s_thing = x;
+}
+
+void pd_unbind(t_pd *x, t_symbol *s)
+{
+    t_binding **bp, *b;
+    for (bp = &pdhost_bindings; (b = *bp); bp = &b->b_next)
+        if (b->b_sym == s && b->b_pd == x)
+    {
+        *bp = b->b_next;
+        freebytes(b, sizeof(*b));
+        break;
+    }
+    s->s_thing = 0;
+    for (b = pdhost_bindings; b; b = b->b_next)
+        if (b->b_sym == s)
+    {
+        s->s_thing = b->b_pd;
+        break;
+    }
+}
+
+t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
+{
+    t_binding *b;
+    for (b = pdhost_bindings; b; b = b->b_next)
+        if (b->b_sym == s && *b->b_pd == c)
+            return (b->b_pd);
+    return (0);
+}
+
+void pd_pushsym(t_pd *x) {}
+void pd_popsym(t_pd *x) {}
+
+    /* fold a message into pdhost_outhash if asked to.  Symbols are hashed by name
+    since they're different in each thread. */
+static void pdhost_hashmess(t_symbol *s, int argc, t_atom *argv)
+{
+    unsigned long h = pdhost_outhash;
+    const char *cp;
+    int i;
+    if (!pdhost_hashout)
+        return;
+    for (i = -1; i < argc; i++)
+    {
+        if (i >= 0 && argv[i].a_type == A_FLOAT)
+        {
+            t_float f = argv[i].a_w.w_float;
+            unsigned char *bp = (unsigned char *)&f;
+            unsigned int j;
+            for (j = 0; j < sizeof(f); j++)
+                h = h * 1000003 ^ bp[j];
+        }
+        else if (i < 0 || argv[i].a_type == A_SYMBOL)
+            for (cp = (i < 0 ? s : argv[i].a_w.w_symbol)->s_name; *cp; cp++)
+                h = h * 1000003 ^ (unsigned char)*cp;
+        else h = h * 1000003 ^ argv[i].a_type;
+        h = h * 1000003;
+    }
+    pdhost_outhash = h;
+}
+
+void typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pdhost_nmess++;
+    pdhost_hashmess(s, argc, argv);
+}
+
+static t_class *pdhost_sink_class;
+
+t_pd *pdhost_sink_new(char *name)
+{
+    t_pd *x;
+    pthread_mutex_lock(&pdhost_mutex);
+    if (!pdhost_sink_class)
+        pdhost_sink_class = class_new(gensym("pdhost_sink"), 0, 0,
+            sizeof(t_pd), CLASS_PD, 0);
+    pthread_mutex_unlock(&pdhost_mutex);
+    x = pd_new(pdhost_sink_class);
+    pd_bind(x, gensym(name));
+    return (x);
+}
+
+/* ------------------------- inlets and outlets ---------------------- */
+
+static int pdhost_inlet;
+
+t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2)
+{
+    return ((t_inlet *)&pdhost_inlet);
+}
+
+t_inlet *floatinlet_new(t_object *owner, t_float *fp)
+{
+    return ((t_inlet *)&pdhost_inlet);
+}
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+    t_outlet *x = (t_outlet *)getbytes(sizeof(*x)), **op;
+    for (op = &owner->ob_outlet; *op; op = &(*op)->o_next)
+        ;
+    *op = x;
+    x->o_next = 0;
+    return (x);
+}
+
+void outlet_bang(t_outlet *x)
+{
+    pdhost_nout++;
+    pdhost_hashmess(&s_bang, 0, 0);
+}
+
+void outlet_float(t_outlet *x, t_float f)
+{
+    t_atom a;
+    SETFLOAT(&a, f);
+    pdhost_nout++;
+    pdhost_hashmess(&s_float, 1, &a);
+}
+
+void outlet_symbol(t_outlet *x, t_symbol *s)
+{
+    t_atom a;
+    SETSYMBOL(&a, s);
+    pdhost_nout++;
+    pdhost_hashmess(&s_symbol, 1, &a);
+}
+
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pdhost_nout++;
+    pdhost_hashmess(&s_list, argc, argv);
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+    pdhost_nout++;
+    pdhost_hashmess(s, argc, argv);
+}
+
+/* ------------------------- clocks ----------------------------- */
+
+    /* set clocks are kept in order of time, and those set for the same
+    time in the order they were set, as in Pd.  Logical time is in msec. */
+struct _clock
+{
+    double c_settime;           /* -1 if unset */
+    void *c_owner;
+    t_method c_fn;
+    struct _clock *c_next;
+};
+
+static PDHOST_PERTHREAD t_clock *pdhost_clocks;
+static PDHOST_PERTHREAD double pdhost_now;
+
+t_clock *clock_new(void *owner, t_method fn)
+{
+    t_clock *x = (t_clock *)getbytes(sizeof(*x));
+    x->c_settime = -1;
+    x->c_owner = owner;
+    x->c_fn = fn;
+    x->c_next = 0;
+    return (x);
+}
+
+void clock_unset(t_clock *x)
+{
+    t_clock **cp;
+    if (x->c_settime < 0)
+        return;
+    for (cp = &pdhost_clocks; *cp; cp = &(*cp)->c_next)
+        if (*cp == x)
+    {
+        *cp = x->c_next;
+        break;
+    }
+    x->c_settime = -1;
+}
+
+void clock_set(t_clock *x, double settime)
+{
+    t_clock **cp;
+    clock_unset(x);
+    if (settime < pdhost_now)
+        settime = pdhost_now;
+    x->c_settime = settime;
+    for (cp = &pdhost_clocks; *cp && (*cp)->c_settime <= settime;
+        cp = &(*cp)->c_next)
+            ;
+    x->c_next = *cp;
+    *cp = x;
+}
+
+void clock_delay(t_clock *x, double delaytime)
+{
+    clock_set(x, pdhost_now + (delaytime > 0 ? delaytime : 0));
+}
+
+void clock_free(t_clock *x)
+{
+    clock_unset(x);
+    freebytes(x, sizeof(*x));
+}
+
+double clock_getlogicaltime(void)
+{
+    return (pdhost_now);
+}
+
+double clock_getsystime(void)
+{
+    return (pdhost_now);
+}
+
+double clock_gettimesince(double prevsystime)
+{
+    return (pdhost_now - prevsystime);
+}
+
+double clock_getsystimeafter(double delaytime)
+{
+    return (pdhost_now + delaytime);
+}
+
+int pdhost_runclocks(double until, int maxevents)
+{
+    int n;
+    for (n = 0; n < maxevents && pdhost_clocks &&
+        pdhost_clocks->c_settime <= until; n++)
+    {
+        t_clock *x = pdhost_clocks;
+        pdhost_clocks = x->c_next;
+        pdhost_now = x->c_settime;
+        x->c_settime = -1;
+        (*(void (*)(void *))x->c_fn)(x->c_owner);
+    }
+    if (n < maxevents && until > pdhost_now)
+        pdhost_now = until;
+    return (n);
+}
+
+/* ------------------------- arrays and DSP ---------------------------- */
+
+    /* garrays are opaque, so here one is just its size and contents */
+typedef struct _hostarray
+{
+    t_pd a_pd;
+    int a_n;
+    t_word *a_vec;
+} t_hostarray;
+
+t_word *pdhost_array_new(char *name, int n)
+{
+    t_hostarray *x;
+    pthread_mutex_lock(&pdhost_mutex);
+    if (!garray_class)
+        garray_class = class_new(gensym("array"), 0, 0, sizeof(t_hostarray),
+            CLASS_PD, 0);
+    pthread_mutex_unlock(&pdhost_mutex);
+    x = (t_hostarray *)pd_new(garray_class);
+    x->a_n = n;
+    x->a_vec = (t_word *)getbytes(n * sizeof(t_word));
+    pd_bind(&x->a_pd, gensym(name));
+    return (x->a_vec);
+}
+
+int garray_getfloatwords(t_garray *a, int *size, t_word **vec)
+{
+    t_hostarray *x = (t_hostarray *)a;
+    *size = x->a_n;
+    *vec = x->a_vec;
+    return (1);
+}
+
+void garray_usedindsp(t_garray *a) {}
+
+#define PDHOST_SR 44100
+
+t_float sys_getsr(void)
+{
+    return (PDHOST_SR);
+}
+
+t_signal *pdhost_signal_new(int n)
+{
+    t_signal *sig = (t_signal *)getbytes(sizeof(*sig));
+    sig->s_n = n;
+    sig->s_vec = (t_sample *)getbytes(n * sizeof(t_sample));
+    sig->s_sr = PDHOST_SR;
+    return (sig);
+}
+
+void pdhost_signal_free(t_signal *sig)
+{
+    freebytes(sig->s_vec, sig->s_n * sizeof(t_sample));
+    freebytes(sig, sizeof(*sig));
+}
+
+    /* the DSP chain, laid out as in Pd: each routine followed by its
+    arguments, and returning a pointer to the next one */
+static PDHOST_PERTHREAD t_int *pdhost_chain;
+static PDHOST_PERTHREAD int pdhost_chainsize;
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+    int newsize = pdhost_chainsize + n + 1, i;
+    va_list ap;
+    pdhost_chain = (t_int *)resizebytes(pdhost_chain,
+        pdhost_chainsize * sizeof(t_int), newsize * sizeof(t_int));
+    pdhost_chain[pdhost_chainsize] = (t_int)f;
+    va_start(ap, n);
+    for (i = 0; i < n; i++)
+        pdhost_chain[pdhost_chainsize + 1 + i] = va_arg(ap, t_int);
+    va_end(ap);
+    pdhost_chainsize = newsize;
+}
+
+void pdhost_dsp_tick(void)
+{
+    t_int *w = pdhost_chain, *end = pdhost_chain + pdhost_chainsize;
+    while (w < end)
+        w = (*(t_perfroutine)(*w))(w);
+}
+
+void pdhost_dsp_clear(void)
+{
+    freebytes(pdhost_chain, pdhost_chainsize * sizeof(t_int));
+    pdhost_chain = 0;
+    pdhost_chainsize = 0;
+}
+
+/* ------------------------- miscellaneous ---------------------------- */
+
+#define LOGTEN 2.302585092994
+
+t_float ftom(t_float f)
+{
+    return (f > 0 ? 17.3123405046 * log(.12231220585 * f) : -1500);
+}
+
+t_float mtof(t_float f)
+{
+    if (f <= -1500)
+        return (0);
+    else if (f > 1499)
+        return (mtof(1499));
+    else return (8.17579891564 * exp(.0577622650 * f));
+}
+
+t_float rmstodb(t_float f)
+{
+    if (f <= 0)
+        return (0);
+    else
+    {
+        t_float val = 100 + 20./LOGTEN * log(f);
+        return (val < 0 ? 0 : val);
+    }
+}
+
+t_float dbtorms(t_float f)
+{
+    if (f <= 0)
+        return (0);
+    else
+    {
+        if (f > 485)
+            f = 485;
+    }
+    return (exp((LOGTEN * 0.05) * (f - 100.)));
+}
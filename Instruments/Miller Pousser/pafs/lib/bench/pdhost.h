@@ -0,0 +1,44 @@
+/* pdhost -- just enough of Pd to run externals without it, for benchmarks.
+Include m_pd.h first.
+
+Each thread is an instance of Pd of its own, with its own symbols, bindings,
+clocks, DSP chain and counters.  Classes are shared, so call the setup
+routines before starting other threads; and set instance_hook (see
+../instance/instance.h) to pdhost_instance so that the externals keep their
+state per thread too. */
+
+#define PDHOST_PERTHREAD __thread
+
+    /* counters, cleared by pdhost_resetcounts() */
+extern PDHOST_PERTHREAD long pdhost_nalloc;  /* getbytes(), resizebytes()... */
+extern PDHOST_PERTHREAD long pdhost_nout;    /* messages sent out of outlets */
+extern PDHOST_PERTHREAD long pdhost_nmess;   /* messages sent by typedmess() */
+extern PDHOST_PERTHREAD long pdhost_ngui;    /* writes to the GUI */
+extern PDHOST_PERTHREAD long pdhost_npost;   /* posts and errors */
+    /* if pdhost_hashout is set, a hash of the contents of those messages,
+    to compare runs by (the benchmarks leave it off, since it takes time) */
+extern int pdhost_hashout;
+extern PDHOST_PERTHREAD unsigned long pdhost_outhash;
+void pdhost_resetcounts(void);
+
+    /* something different for each thread */
+void *pdhost_instance(void);
+
+extern int pdhost_verbose;      /* print posts and errors to stderr */
+
+    /* directory that canvas_getdir() returns and files are opened from */
+void pdhost_setdir(char *dir);
+
+    /* run clocks set for logical time "until" (msec) or before, at most
+    "maxevents" of them; returns the number run */
+int pdhost_runclocks(double until, int maxevents);
+
+    /* arrays, signals and the DSP chain */
+t_word *pdhost_array_new(char *name, int n);
+t_signal *pdhost_signal_new(int n);
+void pdhost_signal_free(t_signal *sig);
+void pdhost_dsp_tick(void);
+void pdhost_dsp_clear(void);
+
+    /* an object that swallows messages sent to "name" */
+t_pd *pdhost_sink_new(char *name);
@@ -0,0 +1,196 @@
+/* Several instances of Pd at once.  The same work -- smerdyakov chains
+mixing two corpora, pitchcenter snapping at random, and text playing back a
+sequence with its editor open -- is done once alone, for reference, and
+then in a number of threads at the same time, each an instance of Pd of its
+own (see pdhost.h).  Each thread has to send out exactly what the reference
+did; any state the externals share between instances shows up as a
+difference, or a crash.  This prints one line per round and exits nonzero
+if any thread differed.
+
+usage: stress [-d libdir] [-n nthreads] [-r nrounds] [-v]
+
+where libdir (default "..") is where walk0.txt and walk1.txt are, there are
+4 threads and 10 rounds by default, and -v prints the objects' posts. */
+
+#include "../smerdyakov/smerdyakov.c"
+#include "../pitchcenter/pitchcenter.c"
+#include "../text/text.c"
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "pdhost.h"
+#include "../instance/instance.h"
+
+#define STRESS_MSEC 60000   /* logical time each instance runs for */
+#define STRESS_STEP 10      /* msec between batches of pitches */
+#define STRESS_NPIT 16      /* pitches per batch */
+#define STRESS_NMESS 20000  /* messages in the text */
+
+    /* what an instance sent out, to compare */
+typedef struct _result
+{
+    unsigned long r_hash;
+    long r_nout;
+    long r_nmess;
+    long r_ngui;
+    long r_npost;
+} t_result;
+
+static void stress_run(t_result *r)
+{
+    static int scale[] = {0, 2, 4, 5, 7, 9, 11};
+    t_symbol *chain1 = gensym("stress-1"), *chain2 = gensym("stress-2");
+    t_symbol *sink = gensym("stress-sink");
+    t_smerdyakov *x1, *x2;
+    t_pitchcenter *pc;
+    t_txt *txt;
+    t_atom set[7 * 8], *av;
+    t_pd *sinkobj;
+    unsigned int pitstate = 1;
+    double now;
+    int i;
+
+    pdhost_resetcounts();
+    x1 = (t_smerdyakov *)smerdyakov_new(chain1, 128, 4);
+    x2 = (t_smerdyakov *)smerdyakov_new(chain2, 128, 4);
+    smerdyakov_read(x1, gensym("walk0.txt"), &s_);
+    smerdyakov_read(x2, gensym("walk1.txt"), &s_);
+    smerdyakov_depth(x1, 2.5);
+    smerdyakov_mix(x1, chain1, chain2, 0.5);
+    smerdyakov_play(x1, 1);
+    smerdyakov_play(x2, 1);
+
+    pc = (t_pitchcenter *)pitchcenter_new();
+    for (i = 0; i < 7 * 8; i++)
+        SETFLOAT(&set[i], 12 * (i/7 + 1) + scale[i % 7]);
+    pitchcenter_set(pc, &s_, 7 * 8, set);
+    pitchcenter_tolerance(pc, 0.25);
+
+    sinkobj = pdhost_sink_new("stress-sink");
+    txt = (t_txt *)txt_new();
+    av = (t_atom *)getbytes(4 * STRESS_NMESS * sizeof(t_atom));
+    for (i = 0; i < STRESS_NMESS; i++)
+    {
+        SETFLOAT(&av[4*i], 1 + i % 7);
+        SETSYMBOL(&av[4*i+1], sink);
+        SETFLOAT(&av[4*i+2], i);
+        SETSEMI(&av[4*i+3]);
+    }
+    txt_set(txt, &s_, 4 * STRESS_NMESS, av);
+    freebytes(av, 4 * STRESS_NMESS * sizeof(t_atom));
+    txt_open(txt);
+    txt_start(txt);
+
+    for (now = 0; now < STRESS_MSEC; now += STRESS_STEP)
+    {
+        pdhost_runclocks(now, 0x7fffffff);
+        for (i = 0; i < STRESS_NPIT; i++)
+        {
+            pitstate = pitstate * 435898247 + 382842987;
+            pitchcenter_float(pc, 24 + 84 *
+                ((pitstate & 0x7fffffff) * (1./2147483648.)));
+        }
+    }
+
+    txt_close(txt);
+    pdhost_runclocks(now, 0x7fffffff);
+    pd_free(&txt->x_ob.ob_pd);
+    pd_unbind(sinkobj, sink);
+    pd_free(sinkobj);
+    pd_free(&pc->x_obj.ob_pd);
+    pd_free(&x2->x_ob.ob_pd);
+    pd_free(&x1->x_ob.ob_pd);
+
+    r->r_hash = pdhost_outhash;
+    r->r_nout = pdhost_nout;
+    r->r_nmess = pdhost_nmess;
+    r->r_ngui = pdhost_ngui;
+    r->r_npost = pdhost_npost;
+}
+
+static void *stress_thread(void *arg)
+{
+    stress_run((t_result *)arg);
+    return (0);
+}
+
+static int stress_same(t_result *r1, t_result *r2)
+{
+    return (r1->r_hash == r2->r_hash && r1->r_nout == r2->r_nout &&
+        r1->r_nmess == r2->r_nmess && r1->r_ngui == r2->r_ngui &&
+        r1->r_npost == r2->r_npost);
+}
+
+static double stress_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: stress [-d libdir] [-n nthreads] [-r nrounds] [-v]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = 4, nrounds = 10, round, i, ch, nbad = 0;
+    t_result ref, *results;
+    pthread_t *threads;
+    double starttime;
+    char *dir = "..";
+    while ((ch = getopt(argc, argv, "d:n:r:v")) != -1)
+        switch (ch)
+    {
+    case 'd': dir = optarg; break;
+    case 'n': nthreads = atoi(optarg); break;
+    case 'r': nrounds = atoi(optarg); break;
+    case 'v': pdhost_verbose = 1; break;
+    default: usage();
+    }
+    if (optind < argc || nthreads < 1 || nrounds < 1)
+        usage();
+    pdhost_setdir(dir);
+    instance_hook = pdhost_instance;
+    pdhost_hashout = 1;
+    smerdyakov_setup();
+    pitchcenter_setup();
+    text_setup();
+
+    starttime = stress_now();
+    stress_run(&ref);
+    printf("# reference: %ld messages out, %ld sent, hash %08lx, %.1f msec\n",
+        ref.r_nout, ref.r_nmess, ref.r_hash & 0xffffffff,
+        stress_now() - starttime);
+    if (!ref.r_nout || !ref.r_nmess)
+    {
+        printf("stress: the reference run did nothing\n");
+        return (1);
+    }
+    results = (t_result *)calloc(nthreads, sizeof(t_result));
+    threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    for (round = 0; round < nrounds; round++)
+    {
+        int nsame = 0;
+        starttime = stress_now();
+        for (i = 0; i < nthreads; i++)
+            if (pthread_create(&threads[i], 0, stress_thread, &results[i]))
+        {
+            fprintf(stderr, "stress: can't start thread\n");
+            return (1);
+        }
+        for (i = 0; i < nthreads; i++)
+            pthread_join(threads[i], 0);
+        for (i = 0; i < nthreads; i++)
+            nsame += stress_same(&results[i], &ref);
+        printf("round %d: %d of %d instances match, %.1f msec\n",
+            round + 1, nsame, nthreads, stress_now() - starttime);
+        fflush(stdout);
+        nbad += nthreads - nsame;
+    }
+    printf("stress: %s\n", (nbad ? "FAILED" : "ok"));
+    return (nbad != 0);
+}
@@ -0,0 +1,64 @@
+/* cpu -- find out which instruction sets this machine has.  See cpu.h. */
+
+#include "m_pd.h"
+#include "cpu.h"
+#include <stdlib.h>
+#include <string.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+static char *cpu_names[CPU_NLEVEL] = {"baseline", "sse4.2", "avx2", "avx512"};
+static int cpu_thelevel = -1;
+
+    /* ask the processor directly rather than through the compiler's
+    __builtin_cpu_supports(), which needs libgcc that the "ld -shared" in
+    the makefiles doesn't link.  The wider registers are only usable if the
+    operating system saves them, which XCR0 tells. */
+static int cpu_probe(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    unsigned int a, b, c, d, xcr0 = 0;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_2))
+        return (CPU_BASELINE);
+    if ((c & bit_OSXSAVE) && (c & bit_AVX) && (c & bit_FMA))
+        __asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "edx");
+    if ((xcr0 & 0x6) != 0x6 || !__get_cpuid_count(7, 0, &a, &b, &c, &d) ||
+        !(b & bit_AVX2))
+            return (CPU_SSE42);
+        /* the AVX-512 kernels may use the BW, DQ and VL extensions too */
+    if ((xcr0 & 0xe6) == 0xe6 && (b & bit_AVX512F) && (b & bit_AVX512BW) &&
+        (b & bit_AVX512DQ) && (b & bit_AVX512VL))
+            return (CPU_AVX512);
+    return (CPU_AVX2);
+#else
+    return (CPU_BASELINE);
+#endif
+}
+
+int cpu_level(void)
+{
+    if (cpu_thelevel < 0)
+    {
+        char *s = getenv("PAFS_CPU");
+        int i;
+        cpu_thelevel = cpu_probe();
+        if (s)
+        {
+            for (i = 0; i < CPU_NLEVEL; i++)
+                if (!strcmp(s, cpu_names[i]))
+                    break;
+            if (i == CPU_NLEVEL)
+                post("warning: PAFS_CPU=%s: not one of baseline, sse4.2, "
+                    "avx2, avx512", s);
+            else if (i < cpu_thelevel)
+                cpu_thelevel = i;
+        }
+    }
+    return (cpu_thelevel);
+}
+
+char *cpu_levelname(int level)
+{
+    return (level >= 0 && level < CPU_NLEVEL ? cpu_names[level] : "unknown");
+}
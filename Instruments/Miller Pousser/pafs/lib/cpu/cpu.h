@@ -0,0 +1,39 @@
+/* cpu -- choose among versions of a DSP kernel compiled for different
+instruction sets.
+
+A kernel lives in a file of its own, which the makefile compiles once for
+each level below with the matching compiler flags and with CPU_SUFFIX
+defined as _baseline, _sse42, _avx2, or _avx512.  Inside it, name the
+kernel CPU_KERNEL(foo); the four objects then define foo_baseline,
+foo_sse42, and so on.  The class declares them with CPU_DECLARE and, in
+its setup routine, picks one with CPU_PICK(foo), which returns the
+version for the best level this machine has.  On other than Intel
+machines all four are compiled the same way and the baseline is used.
+
+Setting the environment variable PAFS_CPU to one of the level names holds
+every class down to that level, to compare them or to work around a bug. */
+
+#define CPU_BASELINE 0
+#define CPU_SSE42 1
+#define CPU_AVX2 2
+#define CPU_AVX512 3
+#define CPU_NLEVEL 4
+
+int cpu_level(void);
+char *cpu_levelname(int level);
+
+#define CPU_CAT2(a, b) a##b
+#define CPU_CAT(a, b) CPU_CAT2(a, b)
+
+#ifdef CPU_SUFFIX
+#define CPU_KERNEL(name) CPU_CAT(name, CPU_SUFFIX)
+#endif
+
+    /* declare all versions of a kernel of type "type" (a function type) */
+#define CPU_DECLARE(type, name) \
+    extern type name##_baseline, name##_sse42, name##_avx2, name##_avx512
+
+#define CPU_PICK(name) \
+    (cpu_level() >= CPU_AVX512 ? name##_avx512 : \
+        (cpu_level() >= CPU_AVX2 ? name##_avx2 : \
+            (cpu_level() >= CPU_SSE42 ? name##_sse42 : name##_baseline)))
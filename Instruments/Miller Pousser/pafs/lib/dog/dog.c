@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "m_pd.h"
+#include "../guibatch/guibatch.h"
 /* dog -- open a dialog with fields for a name and number */
 
 static t_class *dog_class;
@@ -48,15 +49,17 @@ static void dog_list(t_dog *x, t_symbol *s, int argc, t_atom *argv)
     int i;
     gfxstub_deleteforkey(x);
     char cmdbuf[MAXPDSTRING];
-    sys_gui("global ddd_fields; set ddd_fields {}\n");
+    guibatch_add("global ddd_fields; set ddd_fields {}\n");
     for (i = 0; i < x->x_nfields; i++)
     {
         if (i >= argc || argv[i].a_type != A_FLOAT)
-            sys_vgui("lappend ddd_fields {%s {%s}}\n",
+            guibatch_add("lappend ddd_fields {%s {%s}}\n",
                 x->x_fields[i]->s_name, atom_getsymbolarg(i, argc, argv)->s_name);
-        else sys_vgui("lappend ddd_fields {%s {%g}}\n",
+        else guibatch_add("lappend ddd_fields {%s {%g}}\n",
                 x->x_fields[i]->s_name, atom_getfloatarg(i, argc, argv));
     }
+        /* the fields have to be there before gfxstub_new() opens the dialog */
+    guibatch_flush();
     sprintf(cmdbuf, "ddd_dialog %%s %s\n", x->x_name->s_name);
     gfxstub_new(&x->x_obj.ob_pd, x, cmdbuf);
 }
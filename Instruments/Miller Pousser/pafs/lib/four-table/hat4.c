@@ -6,262 +6,749 @@ related to this program. */
 squares is nearly constant, and whose spectra are each "hat functions" with
 512 partials. */
 
-#include "stdio.h"
-#include "math.h"
-#define NPOINTS 4096
+/* usage: hat4 [options]
+    -t ntables      number of tables (4)
+    -n npoints      points per table, a power of two (4096)
+    -p npartials    number of partials, fewer than npoints (512)
+    -a law          amplitudes: linear, hanning, or halfsine (linear)
+    -s nstarts      number of independent searches (1)
+    -j nthreads     threads to run them on (one per processor)
+    -c file         checkpoint the phases to this file ...
+    -i seconds      ... this often (60)
+    -r              resume from the checkpoint file(s)
+    -o format       text, raw, or wav (text)
+    -f file         write the tables here instead of to standard output
+    -g nguard       guard points repeated at the end (0 for text, else 3)
 
-#define TEST 4096
-#define NS 512
+With more than one start, the first starts from the usual fixed phases
+(if there are four tables) and the others from random ones, on a pool of
+threads.  The best set of tables found is the one written out, and each
+start is checkpointed to its own file (the name, a period, and the start
+number).
 
-float amp[NS];
-float pha1[NS], pha2[NS], pha3[NS], pha4[NS];
+Text output is one line per point, with a column for each table.  Raw
+output is the same as interleaved little-endian 32-bit floats, and wav
+output adds a header; either can be read straight into arrays with, for
+example, "soundfiler read -resize hat4.wav hat41 hat42 hat43 hat44". With
+the default three guard points, these tables are laid out like the
+hat4*.txt files. */
 
-#define SS 65536
-double cosines[SS];
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
-double fbuf1[NPOINTS], fbuf2[NPOINTS], fbuf3[NPOINTS], fbuf4[NPOINTS];
-float grain;
-float bestone = 100000;
-float minimprove = 0.001;
+#define TWOPI (2 * 3.14159265358979)
+#define LANES 4     /* independent phase accumulators in prepare() */
+
+    /* these are set from the command line and not changed after */
+int ntab = 4;
+int npoints = 4096;
+int ns = 512;
+float *amp;
 int minstrat;
-/* #define HANNING */
+char *checkfile;
+int checkinterval = 60;
+int resume;
+
+    /* amplitude laws; the old compile-time flags still pick the default */
+#define LINEAR 0
+#define HANNING 1
+#define HALFSINE 2
+static char *lawnames[] = {"linear", "hanning", "halfsine"};
+#ifdef HANNING_DEFAULT
+int amplaw = HANNING;
+#else
+#ifdef HALFSINE_DEFAULT
+int amplaw = HALFSINE;
+#else
+int amplaw = LINEAR;
+#endif
+#endif
 
-float badness(int size)
+    /* the schedule of (minimprove, grain) pairs each search goes through */
+static struct
 {
-    double min = 1e20, max = -1, mean = 0, meansq = 0, rval,
-    	meaninv = 0, meaninvsq = 0, meancubed = 0, meaninvcubed = 0,
-	mean4 = 0, meani4 = 0;
-    double average;
-    int i;
-    for (i = 0, average = 0; i < size; i++)
-	average += fbuf1[i] * fbuf1[i] + fbuf2[i] * fbuf2[i]
-            + fbuf3[i] * fbuf3[i] + fbuf4[i] * fbuf4[i];
-    average *= (1. / size);
-    for (i = 0; i < size; i++)
+    float s_minimprove;
+    float s_grain;
+} schedule[] =
+{
+    {0.01, 0.25},
+    {0.001, 0.4},
+    {0.01, 0.25},
+    {0.01, 0.01},
+    {0.001, 0.001},
+    {0.0001, 0.001},
+};
+#define NSCHEDULE ((int)(sizeof(schedule)/sizeof(schedule[0])))
+
+/* Everything one search changes is kept in its own structure, so that
+several can run at once in different threads.
+
+A trial change to one partial of one table is tried out in a single pass
+that computes the new table values, the new sum of squares of all the
+tables at each point, and the power sums of that (less a shift near its
+mean, to keep precision) from which the badness is found.  The results go
+into spare buffers which are swapped in if the change is kept, so that
+nothing has to be undone otherwise. */
+
+typedef struct _search
+{
+    int x_start;                    /* which start this is */
+    int x_verbose;                  /* print each improvement */
+    int x_step;                     /* step of schedule we're in */
+    float **x_pha;                  /* phases, ntab by ns */
+    double **x_fbuf;                /* tables, ntab by npoints */
+    double *x_sumsq;                /* sum of squares of tables at each point */
+    double *x_newsumsq;             /* results of a trial */
+    double *x_newfbuf;
+    double x_shift;                 /* mean of sumsq, subtracted from it */
+    double x_newshift;              /* mean of newsumsq */
+    double *x_partcos;              /* the partial being adjusted */
+    double *x_partsin;
+    double *x_re;                   /* for FFT */
+    double *x_im;
+    float x_grain;
+    float x_minimprove;
+    float x_bestone;
+    time_t x_checktime;             /* when we last checkpointed */
+} t_search;
+
+void *getmem(size_t n)
+{
+    void *ret = malloc(n);
+    if (!ret)
     {
-    	double val = fbuf1[i] * fbuf1[i] + fbuf2[i] * fbuf2[i]
-	    + fbuf3[i] * fbuf3[i] + fbuf4[i] * fbuf4[i] ;
-	double oops = val - average;
-	if (val < min)
-	    min = val;
-	if (val > max) 
-	    max = val;
-	meansq += oops * oops;
-	mean4 += oops * oops * oops * oops;
+    	fprintf(stderr, "hat4: out of memory\n");
+	exit(1);
     }
+    return (ret);
+}
 
-    meansq = sqrt(meansq/size);
-    mean4  = sqrt(sqrt(mean4/size));
-
+    /* badness from power sums of (sumsq - shift) */
+float moments(int size, double s1, double s2, double s3, double s4)
+{
+    double m = s1/size, m2, m4;
+    m2 = s2/size - m*m;
+    m4 = s4/size - 4*m*(s3/size) + 6*m*m*(s2/size) - 3*m*m*m*m;
+    if (m2 < 0)
+        m2 = 0;
+    if (m4 < 0)
+        m4 = 0;
     if (minstrat == 1)
-    	rval = mean4;
-    else rval = meansq;
-    return (rval);
+    	return (sqrt(sqrt(m4)));
+    else return (sqrt(m2));
+}
+
+    /* recompute sumsq from the tables and return the badness */
+float badness(t_search *x, int size)
+{
+    double s1 = 0, s2 = 0, s3 = 0, s4 = 0, *sumsq = x->x_sumsq;
+    int i, tab;
+    for (i = 0; i < size; i++)
+    	sumsq[i] = 0;
+    for (tab = 0; tab < ntab; tab++)
+    {
+    	double *fbuf = x->x_fbuf[tab];
+	for (i = 0; i < size; i++)
+	    sumsq[i] += fbuf[i] * fbuf[i];
+    }
+    for (i = 0; i < size; i++)
+    	s1 += sumsq[i];
+    x->x_shift = s1 / size;
+    for (i = 0, s1 = 0; i < size; i++)
+    {
+	double d = sumsq[i] - x->x_shift, dsq = d * d;
+	s1 += d;
+	s2 += dsq;
+	s3 += dsq * d;
+	s4 += dsq * dsq;
+    }
+    return (moments(size, s1, s2, s3, s4));
 }
 
-void badness2(int size)
+    /* print the range of the sum of squares; call badness() first */
+void badness2(t_search *x, int size)
 {
-    float min = 1e20, max = -1, mean = 0, meansq = 0;
+    float min = 1e20, max = -1;
     int i;
     for (i = 0; i < size; i++)
     {
-    	float val = fbuf1[i] * fbuf1[i] + fbuf2[i] * fbuf2[i]
-	    + fbuf3[i] * fbuf3[i] + fbuf4[i] * fbuf4[i] ;
+    	float val = x->x_sumsq[i];
 	if (val < min)
 	    min = val;
-	if (val > max) 
+	if (val > max)
 	    max = val;
-    	mean += val;
-	meansq += val * val;
     }
-    /* fprintf(stderr, "- %f\n", m); */
-    mean *= (1./size);
-    meansq *= (1./size);
     fprintf(stderr, "\nmin %f, max %f range %f dB\n", min, max,
-    	20 * log(min <= 0 ? 1e20 : max/min)/log(10.)); 
+    	20 * log(min <= 0 ? 1e20 : max/min)/log(10.));
+}
+
+    /* in-place complex FFT; "size" must be a power of two.  With sign = 1
+    this is the (unnormalized) inverse transform. */
+void fft(int size, double *re, double *im, int sign)
+{
+    int i, j, k, m;
+    for (i = 1, j = 0; i < size; i++)   /* bit-reversal permutation */
+    {
+    	int bit = size >> 1;
+	for (; j & bit; bit >>= 1)
+	    j ^= bit;
+	j |= bit;
+	if (i < j)
+	{
+	    double tmp;
+	    tmp = re[i], re[i] = re[j], re[j] = tmp;
+	    tmp = im[i], im[i] = im[j], im[j] = tmp;
+	}
+    }
+    for (m = 1; m < size; m <<= 1)
+    {
+    	double wr = cos(sign * TWOPI / (2*m)), wi = sin(sign * TWOPI / (2*m));
+	for (i = 0; i < size; i += 2*m)
+	{
+	    double cr = 1, ci = 0;
+	    for (j = i; j < i + m; j++)
+	    {
+	    	double tr, ti, tmp;
+		k = j + m;
+		tr = re[k] * cr - im[k] * ci;
+		ti = re[k] * ci + im[k] * cr;
+		re[k] = re[j] - tr;
+		im[k] = im[j] - ti;
+		re[j] += tr;
+		im[j] += ti;
+		tmp = cr * wr - ci * wi;
+		ci = cr * wi + ci * wr;
+		cr = tmp;
+	    }
+	}
+    }
 }
 
-float build(int size, float *pha, double *fbuf)
+    /* make table "tab" from its spectrum with an inverse FFT; partial j is
+    harmonic j+1 */
+void build(t_search *x, int size, int tab)
 {
+    double *re = x->x_re, *im = x->x_im, *fbuf = x->x_fbuf[tab];
+    float *pha = x->x_pha[tab];
     int i, j;
-    float norm = (1./size);
     for (i = 0; i < size; i++)
+    	re[i] = im[i] = 0;
+    for (j = 0; j < ns && j+1 < size; j++)
     {
-	float foo = 0;
-	for (j = 0; j < NS; j++)
-	    foo += amp[j] * 
-	    	cosines[(int)(SS * ((j+1)*i*norm + pha[j])) & (SS-1)];
-	fbuf[i] = foo;
+    	re[j+1] = amp[j] * cos(TWOPI * pha[j]);
+	im[j+1] = amp[j] * sin(TWOPI * pha[j]);
     }
-    return (badness(size));
+    fft(size, re, im, 1);
+    for (i = 0; i < size; i++)
+    	fbuf[i] = re[i];
 }
 
+    /* find the cosine and sine of partial "npartial" of table "tab" at each
+    point, from which trial() gets the change from any phase shift.  These
+    are made by rotating LANES phasors, each starting at one of the first
+    LANES points and advancing LANES points at a time, so that the inner
+    loop has no dependencies between lanes and can be vectorized. */
+void prepare(t_search *x, int size, int tab, int npartial)
+{
+    double c[LANES], sn[LANES], stepc, steps, incr;
+    double a = amp[npartial], ph = x->x_pha[tab][npartial];
+    double *partcos = x->x_partcos, *partsin = x->x_partsin;
+    int i, k;
+    incr = TWOPI * (npartial+1) / size;
+    for (k = 0; k < LANES; k++)
+    {
+    	c[k] = a * cos(incr * k + TWOPI * ph);
+	sn[k] = a * sin(incr * k + TWOPI * ph);
+    }
+    stepc = cos(incr * LANES);
+    steps = sin(incr * LANES);
+    for (i = 0; i + LANES <= size; i += LANES)
+    {
+    	for (k = 0; k < LANES; k++)
+	{
+	    double tmp = c[k] * stepc - sn[k] * steps;
+	    partcos[i+k] = c[k];
+	    partsin[i+k] = sn[k];
+	    sn[k] = sn[k] * stepc + c[k] * steps;
+	    c[k] = tmp;
+	}
+    }
+    for (k = 0; i < size; i++, k++)
+    {
+    	partcos[i] = c[k];
+	partsin[i] = sn[k];
+    }
+}
 
-void addon(int size, int npartial, float sign, float *pha, double *fbuf)
+    /* try moving the prepared partial of table "tab" by "dpha", leaving the
+    results in newfbuf and newsumsq, and return the badness */
+float trial(t_search *x, int size, int tab, float dpha)
 {
+    double s1 = 0, s2 = 0, s3 = 0, s4 = 0, *fb = x->x_fbuf[tab];
+    double *sumsq = x->x_sumsq, *newfbuf = x->x_newfbuf,
+    	*newsumsq = x->x_newsumsq, shift = x->x_shift;
+    double *partcos = x->x_partcos, *partsin = x->x_partsin;
+    double c = cos(TWOPI * dpha) - 1, sn = sin(TWOPI * dpha);
     int i;
-    float norm = (1./size);
     for (i = 0; i < size; i++)
-	fbuf[i] += sign * amp[npartial] *
-	    cosines[(int)(SS * ((npartial+1)*i*norm + pha[npartial])) & (SS-1)];
+    {
+    	/* cos(x + y) - cos(x) = cos(x)(cos(y) - 1) - sin(x)sin(y) */
+	double f = fb[i] + partcos[i] * c - partsin[i] * sn;
+	double v = sumsq[i] + (f * f - fb[i] * fb[i]), d = v - shift,
+	    dsq = d * d;
+	newfbuf[i] = f;
+	newsumsq[i] = v;
+	s1 += d;
+	s2 += dsq;
+	s3 += dsq * d;
+	s4 += dsq * dsq;
+    }
+    x->x_newshift = shift + s1/size;
+    return (moments(size, s1, s2, s3, s4));
+}
 
+    /* keep the last trial by swapping its buffers in */
+void keep(t_search *x, int tab, int npartial, float newpha)
+{
+    double *tmp;
+    tmp = x->x_fbuf[tab], x->x_fbuf[tab] = x->x_newfbuf, x->x_newfbuf = tmp;
+    tmp = x->x_sumsq, x->x_sumsq = x->x_newsumsq, x->x_newsumsq = tmp;
+    x->x_pha[tab][npartial] = newpha;
+    x->x_shift = x->x_newshift;
 }
 
-int optimizefor(float *pha, double *fbuf, int i)
+int optimizefor(t_search *x, int tab, int i)
 {
-    float was = pha[i], tmp;
+    float was = x->x_pha[tab][i], tmp, grain = x->x_grain;
 
-    addon(TEST, i, -1, pha, fbuf);
-    pha[i] = was + grain;
-    addon(TEST, i, 1, pha, fbuf);
-    if ((tmp = badness(TEST)) < bestone - minimprove)
+    prepare(x, npoints, tab, i);
+    if ((tmp = trial(x, npoints, tab, grain)) <
+    	x->x_bestone - x->x_minimprove)
     {
-	bestone = tmp;
-	fprintf(stderr, "%7.6f ", bestone);
+    	keep(x, tab, i, was + grain);
+	x->x_bestone = tmp;
+	if (x->x_verbose)
+	    fprintf(stderr, "%7.6f ", x->x_bestone);
 	return (1);
     }
-    addon(TEST, i, -1, pha, fbuf);
-    pha[i] = was - grain;
-    addon(TEST, i, 1, pha, fbuf);
-    if ((tmp = badness(TEST)) < bestone - minimprove)
-    {
-	bestone = tmp;
-	fprintf(stderr, "%7.6f ", bestone);
-	fflush(stderr);
+    if ((tmp = trial(x, npoints, tab, -grain)) <
+    	x->x_bestone - x->x_minimprove)
+    {
+    	keep(x, tab, i, was - grain);
+	x->x_bestone = tmp;
+	if (x->x_verbose)
+	{
+	    fprintf(stderr, "%7.6f ", x->x_bestone);
+	    fflush(stderr);
+	}
 	return (1);
     }
-    addon(TEST, i, -1, pha, fbuf);
-    pha[i] = was;
-    addon(TEST, i, 1, pha, fbuf);
     return (0);
 }
 
-void optimize( void)
+    /* checkpoint file for a search; with one start, just the name given */
+void search_checkname(t_search *x, char *buf, int bufsize, int nstarts)
+{
+    if (nstarts > 1)
+    	snprintf(buf, bufsize, "%s.%d", checkfile, x->x_start);
+    else snprintf(buf, bufsize, "%s", checkfile);
+}
+
+    /* write the phases (and where we are in the schedule) to a temporary
+    file and rename it over the checkpoint, so a crash can't leave a
+    half-written one */
+void search_checkpoint(t_search *x, int nstarts)
+{
+    char name[1000], tmpname[1020];
+    FILE *fd;
+    int tab, j;
+    if (!checkfile)
+    	return;
+    search_checkname(x, name, sizeof(name), nstarts);
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", name);
+    if (!(fd = fopen(tmpname, "w")))
+    {
+    	perror(tmpname);
+	return;
+    }
+    fprintf(fd, "hat4 %d %d %d %s %d %d %.9g\n", ntab, npoints, ns,
+    	lawnames[amplaw], x->x_start, x->x_step, x->x_bestone);
+    for (tab = 0; tab < ntab; tab++)
+    	for (j = 0; j < ns; j++)
+	    fprintf(fd, "%.9g\n", x->x_pha[tab][j]);
+    if (fclose(fd) < 0 || rename(tmpname, name) < 0)
+    	perror(name);
+    x->x_checktime = time(0);
+}
+
+    /* read a checkpoint back; return 0 if there's none to be had */
+int search_resume(t_search *x, int nstarts)
+{
+    char name[1000], law[100];
+    FILE *fd;
+    int tab, j, nt, np, nparts, start, step;
+    float bestone;
+    search_checkname(x, name, sizeof(name), nstarts);
+    if (!(fd = fopen(name, "r")))
+    	return (0);
+    if (fscanf(fd, "hat4 %d %d %d %99s %d %d %f", &nt, &np, &nparts, law,
+    	&start, &step, &bestone) < 7 || nt != ntab || np != npoints ||
+	    nparts != ns || strcmp(law, lawnames[amplaw]) || step < 0 ||
+	    	step > NSCHEDULE)
+    {
+    	fprintf(stderr, "hat4: %s: doesn't match these settings\n", name);
+	exit(1);
+    }
+    for (tab = 0; tab < ntab; tab++)
+    	for (j = 0; j < ns; j++)
+	    if (fscanf(fd, "%f", &x->x_pha[tab][j]) < 1)
+    {
+    	fprintf(stderr, "hat4: %s: too short\n", name);
+	exit(1);
+    }
+    fclose(fd);
+    x->x_step = step;
+    x->x_bestone = bestone;
+    fprintf(stderr, "start %d: resuming at step %d from %s\n",
+    	x->x_start, step, name);
+    return (1);
+}
+
+void optimize(t_search *x, int nstarts)
 {
-    int i = 1, nochange = 0, howmany = 0;
-    fprintf(stderr, "------grain %f, minimprove %f minstrat %d -------\n",
-    	grain, minimprove, minstrat);
+    int i = 1, nochange = 0, howmany = 0, tab;
+    if (x->x_verbose)
+	fprintf(stderr, "------grain %f, minimprove %f minstrat %d -------\n",
+    	    x->x_grain, x->x_minimprove, minstrat);
     while (1)
     {
-	float was, tmp;
-	
 	if (howmany <= 0)
 	{
-	    build(TEST, pha1, fbuf1);
-	    build(TEST, pha2, fbuf2);
-	    build(TEST, pha3, fbuf3);
-	    build(TEST, pha4, fbuf4);
-	    
-	    badness2(TEST);
+	    for (tab = 0; tab < ntab; tab++)
+	    	build(x, npoints, tab);
+	    badness(x, npoints);
+	    if (x->x_verbose)
+		badness2(x, npoints);
+	    if (checkfile && time(0) - x->x_checktime >= checkinterval)
+	    	search_checkpoint(x, nstarts);
 	    howmany = 100;
 	}
     	howmany--;
-#if 0
-    	if (optimizefor(pha1, fbuf1, i))
+	for (tab = 0; tab < ntab; tab++)
+	    while (optimizefor(x, tab, i))
+		nochange = 0;
+	if ((++nochange) == ns) break;
+	i ++;
+	i %= ns;
+	if (!i) i = 1;
+    }
+}
+
+    /* start 0 gets the fixed phases this program always used (if there
+    are four tables); the others get random ones from a generator seeded
+    by the start number */
+t_search *search_new(int start, int verbose)
+{
+    t_search *x = (t_search *)getmem(sizeof(*x));
+    unsigned int seed = start * 1319 + 307;
+    int j, tab;
+    x->x_start = start;
+    x->x_verbose = verbose;
+    x->x_step = 0;
+    x->x_checktime = time(0);
+    x->x_pha = (float **)getmem(ntab * sizeof(float *));
+    x->x_fbuf = (double **)getmem(ntab * sizeof(double *));
+    for (tab = 0; tab < ntab; tab++)
+    {
+    	x->x_pha[tab] = (float *)getmem(ns * sizeof(float));
+    	x->x_fbuf[tab] = (double *)getmem(npoints * sizeof(double));
+    }
+    x->x_sumsq = (double *)getmem(npoints * sizeof(double));
+    x->x_newsumsq = (double *)getmem(npoints * sizeof(double));
+    x->x_newfbuf = (double *)getmem(npoints * sizeof(double));
+    x->x_partcos = (double *)getmem(npoints * sizeof(double));
+    x->x_partsin = (double *)getmem(npoints * sizeof(double));
+    x->x_re = (double *)getmem(npoints * sizeof(double));
+    x->x_im = (double *)getmem(npoints * sizeof(double));
+    x->x_bestone = 100000;
+    for (tab = 0; tab < ntab; tab++)
+    	x->x_pha[tab][0] = 0;
+    for (j = 1; j < ns; j++)
+    {
+    	if (!start && ntab == 4)
 	{
-	    nochange = 0;
-	    continue;
-    	}
-    	if (optimizefor(pha2, fbuf2, i))
+	    x->x_pha[0][j] = ((123 * j * j + 5213*j)%700)/700.;
+	    x->x_pha[1][j] = ((457 * j * j + 3769*j)%700)/700.;
+	    x->x_pha[2][j] = ((311 * j * j + 4867*j)%700)/700.;
+	    x->x_pha[3][j] = ((423 * j * j + 8343*j)%700)/700.;
+	}
+	else for (tab = 0; tab < ntab; tab++)
 	{
-	    nochange = 0;
-	    continue;
-    	}
+	    seed = seed * 435898247 + 382842987;
+	    x->x_pha[tab][j] = (seed >> 8) * (1./16777216.);
+	}
+    }
+    return (x);
+}
 
-    	if (optimizefor(pha3, fbuf3, i))
+void search_free(t_search *x)
+{
+    int tab;
+    for (tab = 0; tab < ntab; tab++)
+    {
+    	free(x->x_pha[tab]);
+	free(x->x_fbuf[tab]);
+    }
+    free(x->x_pha);
+    free(x->x_fbuf);
+    free(x->x_sumsq);
+    free(x->x_newsumsq);
+    free(x->x_newfbuf);
+    free(x->x_partcos);
+    free(x->x_partsin);
+    free(x->x_re);
+    free(x->x_im);
+    free(x);
+}
+
+    /* run the rest of the schedule and return the final badness */
+float search_run(t_search *x, int nstarts)
+{
+    int tab;
+    if (resume)
+    	search_resume(x, nstarts);
+    for (; x->x_step < NSCHEDULE; )
+    {
+    	x->x_minimprove = schedule[x->x_step].s_minimprove;
+	x->x_grain = schedule[x->x_step].s_grain;
+	optimize(x, nstarts);
+	x->x_step++;
+	search_checkpoint(x, nstarts);
+    }
+    for (tab = 0; tab < ntab; tab++)
+    	build(x, npoints, tab);
+    return (badness(x, npoints));
+}
+
+    /* the thread pool: each thread takes the next start to run until there
+    are none left, keeping the best search found so far */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int pool_nextstart, pool_nstarts, pool_ndone;
+static t_search *pool_best;
+static float pool_bestbadness;
+
+static void *pool_thread(void *z)
+{
+    (void)z;        /* the pool is in the statics above */
+    while (1)
+    {
+    	t_search *x;
+	float bad;
+	int start;
+	pthread_mutex_lock(&pool_mutex);
+	start = pool_nextstart++;
+	pthread_mutex_unlock(&pool_mutex);
+	if (start >= pool_nstarts)
+	    return (0);
+	x = search_new(start, 0);
+	bad = search_run(x, pool_nstarts);
+	pthread_mutex_lock(&pool_mutex);
+	pool_ndone++;
+	if (!pool_best || bad < pool_bestbadness)
 	{
-	    nochange = 0;
-	    continue;
-    	}
+	    if (pool_best)
+	    	search_free(pool_best);
+	    pool_best = x;
+	    pool_bestbadness = bad;
+	}
+	else search_free(x);
+	fprintf(stderr, "start %d: badness %f (%d of %d done, best %f)\n",
+	    start, bad, pool_ndone, pool_nstarts, pool_bestbadness);
+	pthread_mutex_unlock(&pool_mutex);
+    }
+}
+
+static void putle(FILE *fd, unsigned long n, int nbytes)
+{
+    while (nbytes--)
+    	putc((int)(n & 0xff), fd), n >>= 8;
+}
+
+static void putfloat(FILE *fd, float f)
+{
+    union
+    {
+    	float f;
+	unsigned int u;
+    } u;
+    u.f = f;
+    putle(fd, u.u, 4);
+}
 
-    	if (optimizefor(pha4, fbuf4, i))
+#define TEXT 0
+#define RAW 1
+#define WAV 2
+
+    /* write the tables, normalized so the mean sum of squares is one */
+void writetables(t_search *x, FILE *fd, int format, int nguard)
+{
+    double **fbuf = x->x_fbuf;
+    float total, norm;
+    int i, tab, nframes = npoints + nguard;
+
+    for (i = 0, total = 0; i < npoints; i++)
+    {
+    	double sum = 0;
+	for (tab = 0; tab < ntab; tab++)
+	    sum += fbuf[tab][i]*fbuf[tab][i];
+	total += sum;
+    }
+    norm = sqrt(npoints / total);
+    if (format == WAV)
+    {
+    	unsigned long datasize = 4L * ntab * nframes;
+	fputs("RIFF", fd);
+	putle(fd, 36 + datasize, 4);
+	fputs("WAVEfmt ", fd);
+	putle(fd, 16, 4);
+	putle(fd, 3, 2);                /* IEEE float */
+	putle(fd, ntab, 2);
+	putle(fd, 44100, 4);
+	putle(fd, 44100L * 4 * ntab, 4);
+	putle(fd, 4 * ntab, 2);
+	putle(fd, 32, 2);
+	fputs("data", fd);
+	putle(fd, datasize, 4);
+    }
+    for (i = 0; i < nframes; i++)
+    {
+    	int point = i % npoints;
+	for (tab = 0; tab < ntab; tab++)
 	{
-	    nochange = 0;
-	    continue;
-    	}
-#else
-    	while (optimizefor(pha1, fbuf1, i))
-	    nochange = 0;
-    	while (optimizefor(pha2, fbuf2, i))
-	    nochange = 0;
-    	while (optimizefor(pha3, fbuf3, i))
-	    nochange = 0;
-    	while (optimizefor(pha4, fbuf4, i))
-	    nochange = 0;
-#endif
-	if ((++nochange) == NS) break;
-	i ++;
-	i %= NS;
-	if (!i) i = 1;
+	    if (format == TEXT)
+	    	fprintf(fd, "%f%c", norm * fbuf[tab][point],
+		    (tab == ntab-1 ? '\n' : '\t'));
+	    else putfloat(fd, norm * fbuf[tab][point]);
+	}
     }
 }
 
+static void usage(void)
+{
+    fprintf(stderr, "usage: hat4 [-t ntables] [-n npoints] [-p npartials]\n");
+    fprintf(stderr, "  [-a linear|hanning|halfsine] [-s nstarts] [-j nthreads]\n");
+    fprintf(stderr, "  [-c checkpointfile] [-i seconds] [-r]\n");
+    fprintf(stderr, "  [-o text|raw|wav] [-f outfile] [-g nguard]\n");
+    exit(1);
+}
 
-main(argc, argv)
- char **argv;
+int main(int argc, char **argv)
 {
-    int i = 0, sfd;
-    char *name;
-    short buf[NPOINTS];
-    int j;
-    float sumsq, norm;
-    
+    int i, j, ch, nstarts = 1, nthreads = 0, format = TEXT, nguard = -1;
+    char *outfile = 0;
+    t_search *x;
+    FILE *fd = stdout;
+
+    while ((ch = getopt(argc, argv, "t:n:p:a:s:j:c:i:ro:f:g:")) != -1)
+    	switch (ch)
+    {
+    case 't': ntab = atoi(optarg); break;
+    case 'n': npoints = atoi(optarg); break;
+    case 'p': ns = atoi(optarg); break;
+    case 'a':
+    	for (amplaw = 0; amplaw < 3; amplaw++)
+	    if (!strcmp(optarg, lawnames[amplaw]))
+	    	break;
+	if (amplaw == 3)
+	    usage();
+	break;
+    case 's': nstarts = atoi(optarg); break;
+    case 'j': nthreads = atoi(optarg); break;
+    case 'c': checkfile = optarg; break;
+    case 'i': checkinterval = atoi(optarg); break;
+    case 'r': resume = 1; break;
+    case 'o':
+    	if (!strcmp(optarg, "text"))
+	    format = TEXT;
+	else if (!strcmp(optarg, "raw"))
+	    format = RAW;
+	else if (!strcmp(optarg, "wav"))
+	    format = WAV;
+	else usage();
+	break;
+    case 'f': outfile = optarg; break;
+    case 'g': nguard = atoi(optarg); break;
+    default: usage();
+    }
+    if (optind < argc || ntab < 1 || npoints < 4 ||
+    	(npoints & (npoints - 1)) || ns < 2 || ns >= npoints)
+    	    usage();
+    if (resume && !checkfile)
+    {
+    	fprintf(stderr, "hat4: -r needs a checkpoint file (-c)\n");
+	exit(1);
+    }
+    if (nstarts < 1)
+    	nstarts = 1;
+    if (nguard < 0)
+    	nguard = (format == TEXT ? 0 : 3);
+    amp = (float *)getmem(ns * sizeof(float));
     amp[0] = 0.5;
-    pha1[0] = pha2[0] = pha3[0] = pha4[0] = 0;
-    for (j = 1; j < NS; j++)
-    {
-	pha1[j] = ((123 * j * j + 5213*j)%700)/700.;
-	pha2[j] = ((457 * j * j + 3769*j)%700)/700.;
-	pha3[j] = ((311 * j * j + 4867*j)%700)/700.;
-	pha4[j] = ((423 * j * j + 8343*j)%700)/700.;
-#ifdef HANNING
-	amp[j] = 0.5 * (1 + cos(3.14159*j / (float)NS));
-#else
-#ifdef HALFSINE
-	amp[j] = cos(3.14159*0.5*j / (float)NS);
-#else
-	amp[j] = (NS - j) / (float)NS;
-#endif
-#endif
+    for (j = 1; j < ns; j++)
+    {
+    	if (amplaw == HANNING)
+	    amp[j] = 0.5 * (1 + cos(3.14159*j / (float)ns));
+	else if (amplaw == HALFSINE)
+	    amp[j] = cos(3.14159*0.5*j / (float)ns);
+	else amp[j] = (ns - j) / (float)ns;
+    }
+
+    minstrat = 1;
+    if (nstarts == 1)
+    {
+    	x = search_new(0, 1);
+	fprintf(stderr, "badness %f\n", search_run(x, 1));
+    }
+    else
+    {
+    	pthread_t *threads;
+	if (nthreads < 1 && (nthreads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+	    nthreads = 1;
+	if (nthreads > nstarts)
+	    nthreads = nstarts;
+	fprintf(stderr, "%d starts on %d threads\n", nstarts, nthreads);
+	pool_nstarts = nstarts;
+	threads = (pthread_t *)getmem(nthreads * sizeof(*threads));
+	for (i = 0; i < nthreads; i++)
+	    if (pthread_create(&threads[i], 0, pool_thread, 0))
+	{
+	    fprintf(stderr, "hat4: can't create thread\n");
+	    exit(1);
+	}
+	for (i = 0; i < nthreads; i++)
+	    pthread_join(threads[i], 0);
+	free(threads);
+	x = pool_best;
+	fprintf(stderr, "best: start %d, badness %f\n", x->x_start,
+	    pool_bestbadness);
     }
-    for (j = 0; j < SS; j++)
-	cosines[j] = cos((2*3.14159/SS)*j);
-
-    minstrat = 1;	
-    minimprove = 0.01;
-    grain = 0.25;
-    optimize();
-    minimprove = 0.001;
-    grain = 0.4;
-    optimize();
-    minimprove = 0.01;
-    grain = 0.25;
-    optimize();
-    minimprove = 0.01;
-    grain = 0.01;	
-    optimize();
-    minimprove = 0.001;
-    grain = 0.001;	
-    optimize();
-    minimprove = 0.0001;
-    grain = 0.001;	
-    optimize();
-
-    build(NPOINTS, pha1, fbuf1);
-    build(NPOINTS, pha2, fbuf2);
-    build(NPOINTS, pha3, fbuf3);
-    build(NPOINTS, pha4, fbuf4);
-    fprintf(stderr, "badness %f\n", badness(NPOINTS));
-    badness2(NPOINTS);
-
-    for (i = 0, sumsq = 0; i < NPOINTS; i++)
-    	sumsq += fbuf1[i]*fbuf1[i] + fbuf2[i]*fbuf2[i] +
-	    fbuf3[i]*fbuf3[i] + fbuf4[i]*fbuf4[i];
-    norm = sqrt(NPOINTS / sumsq);
-    for (i = 0; i < NPOINTS; i++) 
-	printf("%f\t%f\t%f\t%f\n", norm * fbuf1[i], 
-	    norm * fbuf2[i], norm * fbuf3[i], norm * fbuf4[i]);
+    badness2(x, npoints);
 
+    if (outfile && !(fd = fopen(outfile, (format == TEXT ? "w" : "wb"))))
+    {
+    	perror(outfile);
+	exit(1);
+    }
+    writetables(x, fd, format, nguard);
+    if (fd != stdout)
+    	fclose(fd);
+
+    search_free(x);
+    free(amp);
     exit(0);
 }
-
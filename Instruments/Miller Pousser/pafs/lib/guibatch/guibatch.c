@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "m_pd.h"
+#include "guibatch.h"
+#include "../instance/instance.h"
+
+/* Commands are appended to one growable buffer, which is sent with a single
+sys_gui() by a clock set for the current logical time, so that everything
+added during a scheduler tick goes out in one write at the end of it.
+Anything that has to reach the GUI after these commands by some other route
+(gfxstub_new() for instance) should call guibatch_flush() first.  Each Pd
+instance has its own buffer and clock. */
+
+#define GUIBATCH_INITSIZE 1024
+
+typedef struct _guibatch
+{
+    char *g_buf;
+    int g_size;
+    int g_fill;
+    t_clock *g_clock;
+} t_guibatch;
+
+static t_instancekey guibatch_key = INSTANCE_KEY(t_guibatch);
+
+static void guibatch_doflush(t_guibatch *g)
+{
+    if (!g->g_fill)
+    	return;
+    clock_unset(g->g_clock);
+    sys_gui(g->g_buf);
+    g->g_fill = 0;
+    g->g_buf[0] = 0;
+}
+
+void guibatch_flush(void)
+{
+    guibatch_doflush((t_guibatch *)instance_get(&guibatch_key));
+}
+
+static void guibatch_tick(t_guibatch *g)
+{
+    guibatch_doflush(g);
+}
+
+void guibatch_add(char *fmt, ...)
+{
+    t_guibatch *g = (t_guibatch *)instance_get(&guibatch_key);
+    va_list ap;
+    int n;
+    if (!g->g_clock)
+    {
+    	g->g_buf = (char *)getbytes(GUIBATCH_INITSIZE);
+	g->g_size = GUIBATCH_INITSIZE;
+	g->g_clock = clock_new(g, (t_method)guibatch_tick);
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(g->g_buf + g->g_fill, g->g_size - g->g_fill, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+    {
+    	g->g_buf[g->g_fill] = 0;
+	return;
+    }
+    if (g->g_fill + n >= g->g_size)
+    {
+    	int newsize = g->g_size;
+	while (newsize <= g->g_fill + n)
+	    newsize *= 2;
+	g->g_buf = (char *)resizebytes(g->g_buf, g->g_size, newsize);
+	g->g_size = newsize;
+	va_start(ap, fmt);
+	vsnprintf(g->g_buf + g->g_fill, g->g_size - g->g_fill, fmt, ap);
+	va_end(ap);
+    }
+    if (!g->g_fill)
+    	clock_delay(g->g_clock, 0);
+    g->g_fill += n;
+}
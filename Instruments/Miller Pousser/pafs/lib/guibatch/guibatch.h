@@ -0,0 +1,4 @@
+/* guibatch -- collect Tcl commands and send them to the GUI all at once */
+
+void guibatch_add(char *fmt, ...);
+void guibatch_flush(void);
@@ -1,65 +1,235 @@
 #include "m_pd.h"
-#include <stdlib.h>
+#include "histodog.h"
+#include "../profile/profile.h"
 
 /* histodog -- do a by-power histogram to find important pitches in 
 recent history */
 
+/* Rather than rebuilding the histogram from the history on every query,
+we keep a running histogram for each window length recently asked for, and
+update it as each new pitch comes in (adding the new one and subtracting the
+one that just fell out of the window).  A query then only has to smooth the
+histogram and pick out the peaks (see histopick.c).
+
+The first creation argument sets the length of the history (default 1000).
+If a second argument between 0 and 1 is given, there's no history at all;
+instead each incoming pitch multiplies the histogram by that factor before
+adding its own weight, and "wtf" ignores its window length.  The decay is
+done lazily by scaling up new weights, so it costs nothing per bin. */
+
 static t_class *histodog_class;
 
-#define HISTORY 1000
-#define LOPITCH 0
-#define NPITCH 128
-#define MAXOUT 20
+#define DEFHISTORY 1000
+#define MAXWINDOW 4             /* number of running windows kept */
 
 typedef struct _snap
 {
     float s_pit;
     float s_weight;
+    int s_bin;          /* histogram bin, or -1 if not counted */
 } t_snap;
 
+typedef struct _window
+{
+    int w_nhist;                /* length of window, or -1 if decaying */
+    int w_lastused;             /* for choosing a window to recycle */
+    int w_n;                    /* number of snapshots counted */
+    double w_sum;               /* sum of their weights */
+    double w_histo[NBIN];
+    int w_count[NBIN];          /* snapshots in each bin */
+} t_window;
+
 typedef struct _histodog
 {
     t_object x_obj;
     t_outlet *x_outlet;
     t_float x_f;
-    t_snap x_snap[HISTORY];
+    t_snap *x_snap;             /* history, or 0 if decaying */
+    int x_nsnap;
     int x_histphase;
+    t_window *x_window[MAXWINDOW];  /* allocated as needed */
+    int x_usecount;
+    double x_decay;             /* decay factor, or 0 to use history */
+    double x_gain;              /* current scaling of new weights */
+    PROFILE_FIELD
 } t_histodog;
 
-static void *histodog_new(void)
+static void histodog_clear(t_histodog *x);
+
+static void *histodog_new(t_floatarg fhist, t_floatarg fdecay)
 {
     int i;
     t_histodog *x = (t_histodog *)pd_new(histodog_class);
     x->x_outlet = outlet_new(&x->x_obj, &s_list);
     floatinlet_new(&x->x_obj, &x->x_f);
-    x->x_histphase = 0;
-    for (i = 0; i <HISTORY; i++)
-        x->x_snap[i].s_pit = x->x_snap[i].s_weight = 0;
+    for (i = 0; i < MAXWINDOW; i++)
+        x->x_window[i] = 0;
+    if (fdecay > 0 && fdecay < 1)
+    {
+        x->x_decay = fdecay;
+        x->x_snap = 0;
+        x->x_nsnap = 0;
+        x->x_window[0] = (t_window *)getbytes(sizeof(t_window));
+    }
+    else
+    {
+        x->x_decay = 0;
+        if ((x->x_nsnap = fhist) < 1)
+            x->x_nsnap = DEFHISTORY;
+        x->x_snap = (t_snap *)getbytes(x->x_nsnap * sizeof(t_snap));
+    }
+    histodog_clear(x);
+    PROFILE_INIT(&x->x_profile, "float", "wtf");
     return (x);
 }
 
-static void histodog_float(t_histodog *x, t_floatarg f)
+static void histodog_free(t_histodog *x)
+{
+    int i;
+    if (x->x_snap)
+        freebytes(x->x_snap, x->x_nsnap * sizeof(t_snap));
+    for (i = 0; i < MAXWINDOW; i++)
+        if (x->x_window[i])
+            freebytes(x->x_window[i], sizeof(t_window));
+}
+
+static void window_add(t_window *w, t_snap *sp)
+{
+    if (sp->s_bin >= 0)
+    {
+        w->w_histo[sp->s_bin] += sp->s_weight;
+        w->w_count[sp->s_bin]++;
+        w->w_sum += sp->s_weight;
+        w->w_n++;
+    }
+}
+
+    /* when a bin (or the whole window) empties, zero it exactly so that
+    rounding errors can't leave phantom peaks behind */
+static void window_remove(t_window *w, t_snap *sp)
+{
+    if (sp->s_bin >= 0)
+    {
+        if (--w->w_count[sp->s_bin] <= 0)
+            w->w_histo[sp->s_bin] = 0, w->w_count[sp->s_bin] = 0;
+        else w->w_histo[sp->s_bin] -= sp->s_weight;
+        if (--w->w_n <= 0)
+            w->w_sum = 0, w->w_n = 0;
+        else w->w_sum -= sp->s_weight;
+    }
+}
+
+    /* bring the decaying histogram back to unit gain, dropping bins that
+    have decayed to nothing compared to the total */
+static void histodog_renormalize(t_histodog *x)
+{
+    t_window *w = x->x_window[0];
+    double scale = 1./x->x_gain;
+    int i;
+    w->w_sum *= scale;
+    for (i = 0; i < NBIN; i++)
+        if ((w->w_histo[i] *= scale) < 1e-12 * w->w_sum)
+            w->w_histo[i] = 0;
+    x->x_gain = 1;
+}
+
+static void histodog_dofloat(t_histodog *x, t_floatarg f)
 {
+    t_snap *sp, snap;
+    int i;
     if (x->x_f > 0)
     {
-        x->x_snap[x->x_histphase].s_weight = x->x_f;
-        x->x_snap[x->x_histphase].s_pit = f;
+        snap.s_weight = x->x_f;
+        snap.s_pit = f;
+        snap.s_bin = histodog_bin(f);
+    }
+    else snap.s_weight = snap.s_pit = 0, snap.s_bin = -1;
+    if (x->x_decay > 0)
+    {
+            /* rather than shrinking everything, grow the new weight */
+        x->x_gain /= x->x_decay;
+        if (snap.s_bin >= 0)
+        {
+            x->x_window[0]->w_histo[snap.s_bin] += snap.s_weight * x->x_gain;
+            x->x_window[0]->w_sum += snap.s_weight * x->x_gain;
+        }
+        if (x->x_gain > MAXGAIN)
+            histodog_renormalize(x);
+        return;
+    }
+        /* first take away whatever is falling out of each window */
+    for (i = 0; i < MAXWINDOW; i++)
+        if (x->x_window[i] && x->x_window[i]->w_nhist)
+    {
+        int old = x->x_histphase - x->x_window[i]->w_nhist;
+        if (old < 0)
+            old += x->x_nsnap;
+        window_remove(x->x_window[i], &x->x_snap[old]);
     }
-    else x->x_snap[x->x_histphase].s_weight = 
-        x->x_snap[x->x_histphase].s_pit = 0;
+    sp = &x->x_snap[x->x_histphase];
+    *sp = snap;
+    for (i = 0; i < MAXWINDOW; i++)
+        if (x->x_window[i] && x->x_window[i]->w_nhist)
+            window_add(x->x_window[i], sp);
     x->x_histphase++;
-    if (x->x_histphase >= HISTORY)
+    if (x->x_histphase >= x->x_nsnap)
         x->x_histphase = 0;
 }
 
-static void histodog_wtf(t_histodog *x, t_floatarg fnhist,
+static void histodog_float(t_histodog *x, t_floatarg f)
+{
+    PROFILE_BEGIN;
+    histodog_dofloat(x, f);
+    PROFILE_END(&x->x_profile, 0);
+}
+
+    /* find the running window for a given length, starting one (from the
+    history, just this once) if there isn't one yet */
+static t_window *histodog_getwindow(t_histodog *x, int nhist)
+{
+    int i, histphase;
+    t_window *w = 0;
+    for (i = 0; i < MAXWINDOW; i++)
+        if (x->x_window[i] && x->x_window[i]->w_nhist == nhist)
+    {
+        w = x->x_window[i];
+        goto gotit;
+    }
+    for (i = 0; i < MAXWINDOW; i++)
+    {
+        if (!x->x_window[i])
+        {
+            w = x->x_window[i] = (t_window *)getbytes(sizeof(t_window));
+            PROFILE_ALLOC(&x->x_profile);
+            break;
+        }
+        else if (!w || x->x_window[i]->w_lastused < w->w_lastused)
+            w = x->x_window[i];
+    }
+    w->w_nhist = nhist;
+    w->w_n = 0;
+    w->w_sum = 0;
+    for (i = 0; i < NBIN; i++)
+        w->w_histo[i] = 0, w->w_count[i] = 0;
+    for (i = 0, histphase = x->x_histphase; i < nhist; i++)
+    {
+        if (--histphase < 0)
+            histphase = x->x_nsnap-1;
+        window_add(w, &x->x_snap[histphase]);
+    }
+gotit:
+    w->w_lastused = ++x->x_usecount;
+    return (w);
+}
+
+static void histodog_dowtf(t_histodog *x, t_floatarg fnhist,
     t_floatarg fminout, t_floatarg fmaxout, t_floatarg minfrac)
 {
-    float histo[2*NPITCH+1], sum = 0;
+    double histo[NBIN];
     int nhist = fnhist;
-    int i, j, argc;
-    int histphase;
+    int j;
     int minout = fminout, maxout = fmaxout;
+    t_window *w;
     t_atom argv[MAXOUT];
     if (maxout > MAXOUT)
         maxout = MAXOUT;
@@ -69,67 +239,63 @@ static void histodog_wtf(t_histodog *x, t_floatarg fnhist,
         minout = maxout;
     if (minout < 0)
         minout = 0;
-    if (nhist <= 0)
+    if (x->x_decay > 0)
+        w = x->x_window[0];
+    else if (nhist <= 0)
     {
         bug("histodog");
         return;
     }
-    else if (nhist > HISTORY)
-    {
-        post("histodog: history %d truncated to %d", nhist, HISTORY);
-        nhist = HISTORY;
-    }
-    for (i = 0; i < 2*NPITCH+1; i++)
-        histo[i] = 0;
-    for (i = 0, histphase = x->x_histphase; i < nhist; i++)
-    {
-        int bin;
-        if (--histphase < 0)
-            histphase = HISTORY-1;
-        if (x->x_snap[histphase].s_weight <= 0 ||
-            (bin = 2*(x->x_snap[histphase].s_pit-LOPITCH) + 1) < 1 ||
-                bin >= 2*NPITCH+1)
-                continue;
-        sum += x->x_snap[histphase].s_weight;
-        histo[bin] += x->x_snap[histphase].s_weight;
-    }
-    /* for (i = 0; i < 2*NPITCH+1; i++)
-        post("%.3d %f", i, histo[i]); */
-    for (argc = 0; argc < maxout; argc++)
+    else
     {
-        float bestval = 0, out = 0;
-        int bestindex = -1;
-        for (j = 0; j < 2*NPITCH-1; j++)
-        {
-            float myval = 0.7*histo[j] + histo[j+1] + 0.7*histo[j+2];
-            if (myval > bestval)
-                bestval = myval, bestindex = j;
-        }
-        /* post("bestindex %d, bestval %f, sum %f, minfrac %f",
-            bestindex, bestval, sum, minfrac); */
-        if (bestindex < 0)
-            break;
-        if (bestval < minfrac * sum)
-            break;
-        if (bestindex & 1)
+        if (nhist > x->x_nsnap)
         {
-            if (histo[bestindex] > histo[bestindex+2])
-                 out = bestindex/2;
-            else out = bestindex/2+1;
+            post("histodog: history %d truncated to %d", nhist, x->x_nsnap);
+            nhist = x->x_nsnap;
         }
-        else out = bestindex/2;
-        histo[bestindex] = histo[bestindex+1] = histo[bestindex+2] = 0;
-        SETFLOAT(argv+argc, out);
+        w = histodog_getwindow(x, nhist);
     }
-    outlet_list(x->x_outlet, &s_list, argc, argv);
+    for (j = 0; j < NBIN; j++)
+        histo[j] = w->w_histo[j];
+    outlet_list(x->x_outlet, &s_list,
+        histodog_pick(histo, w->w_sum, maxout, minfrac, argv), argv);
+}
+
+static void histodog_wtf(t_histodog *x, t_floatarg fnhist,
+    t_floatarg fminout, t_floatarg fmaxout, t_floatarg minfrac)
+{
+    PROFILE_BEGIN;
+    histodog_dowtf(x, fnhist, fminout, fmaxout, minfrac);
+    PROFILE_END(&x->x_profile, 1);
 }
 
 static void histodog_clear(t_histodog *x)
 {
     int i;
-    for (i = 0; i <HISTORY; i++)
+    for (i = 0; i < x->x_nsnap; i++)
+    {
         x->x_snap[i].s_pit = x->x_snap[i].s_weight = 0;
-    
+        x->x_snap[i].s_bin = -1;
+    }
+    if (x->x_decay > 0)
+    {
+        t_window *w = x->x_window[0];
+        w->w_nhist = -1;
+        w->w_sum = 0;
+        for (i = 0; i < NBIN; i++)
+            w->w_histo[i] = 0;
+    }
+    else for (i = 0; i < MAXWINDOW; i++)
+        if (x->x_window[i])
+            x->x_window[i]->w_nhist = 0, x->x_window[i]->w_lastused = 0;
+    x->x_gain = 1;
+    x->x_histphase = 0;
+    x->x_usecount = 0;
+}
+
+static void histodog_stats(t_histodog *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "histodog", s);
 }
 
 #if 0
@@ -145,13 +311,16 @@ static void histodog_set(t_histodog *x, t_symbol *s, int argc,
 
 void histodog_setup(void)
 {
-    histodog_class = class_new(gensym("histodog"), histodog_new, 
-        0, sizeof(t_histodog), 0, 0);
+    histodog_class = class_new(gensym("histodog"), (t_newmethod)histodog_new,
+        (t_method)histodog_free, sizeof(t_histodog), 0,
+            A_DEFFLOAT, A_DEFFLOAT, 0);
     class_addfloat(histodog_class, histodog_float);
     class_addmethod(histodog_class, (t_method)histodog_wtf,
         gensym("wtf"), A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, 0);
     class_addmethod(histodog_class, (t_method)histodog_clear,
         gensym("clear"), 0);
+    class_addmethod(histodog_class, (t_method)histodog_stats,
+        gensym("stats"), A_DEFSYM, 0);
 #if 0
     class_addmethod(histodog_class, (t_method)histodog_set,
         gensym("set"), A_GIMME, 0);
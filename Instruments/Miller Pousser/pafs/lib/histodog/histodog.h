@@ -0,0 +1,12 @@
+/* definitions shared by histodog and histodog~ */
+
+#define LOPITCH 0
+#define NPITCH 128
+#define MAXOUT 20
+#define NBIN (2*NPITCH+1)
+#define NSMOOTH (2*NPITCH-1)    /* number of 3-bin smoothed values */
+#define MAXGAIN 1e30            /* renormalize decaying histogram past this */
+
+int histodog_bin(t_float pit);
+int histodog_pick(double *histo, double sum, int maxout, t_float minfrac,
+    t_atom *argv);
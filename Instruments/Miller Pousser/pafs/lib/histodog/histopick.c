@@ -0,0 +1,104 @@
+/* pick the strongest pitches out of a histogram, for histodog and
+histodog~.  Each histogram bin is half a semitone wide. */
+
+#include "m_pd.h"
+#include "histodog.h"
+
+    /* max-heap of smoothed histogram values; ties go to the lower index,
+    as they would in a left-to-right search */
+typedef struct _heapent
+{
+    double h_val;
+    int h_index;
+} t_heapent;
+
+#define HEAPBETTER(a, b) ((a).h_val > (b).h_val || \
+    ((a).h_val == (b).h_val && (a).h_index < (b).h_index))
+
+static void heap_down(t_heapent *heap, int n, int i)
+{
+    while (1)
+    {
+        int best = i, l = 2*i+1, r = 2*i+2;
+        t_heapent tmp;
+        if (l < n && HEAPBETTER(heap[l], heap[best]))
+            best = l;
+        if (r < n && HEAPBETTER(heap[r], heap[best]))
+            best = r;
+        if (best == i)
+            return;
+        tmp = heap[i], heap[i] = heap[best], heap[best] = tmp;
+        i = best;
+    }
+}
+
+    /* histogram bin for a pitch, or -1 if it's out of range */
+int histodog_bin(t_float pit)
+{
+    int bin = 2*(pit-LOPITCH) + 1;
+    return (bin < 1 || bin >= NBIN ? -1 : bin);
+}
+
+#define SMOOTH(h, j) (0.7*(h)[j] + (h)[(j)+1] + 0.7*(h)[(j)+2])
+
+    /* find up to "maxout" peaks in "histo" (which is used as scratch space)
+    stopping at any weaker than "minfrac" times "sum"; put the pitches in
+    "argv" and return how many there were. */
+int histodog_pick(double *histo, double sum, int maxout, t_float minfrac,
+    t_atom *argv)
+{
+    t_heapent heap[NSMOOTH];
+    int j, argc, nheap;
+    /* for (i = 0; i < 2*NPITCH+1; i++)
+        post("%.3d %f", i, histo[i]); */
+    for (j = nheap = 0; j < NSMOOTH; j++)
+    {
+        double myval = SMOOTH(histo, j);
+        if (myval > 0)
+        {
+            heap[nheap].h_val = myval;
+            heap[nheap].h_index = j;
+            nheap++;
+        }
+    }
+    for (j = nheap/2 - 1; j >= 0; j--)
+        heap_down(heap, nheap, j);
+    for (argc = 0; argc < maxout; argc++)
+    {
+        double bestval;
+        float out = 0;
+        int bestindex;
+            /* zeroing bins only ever lowers smoothed values, so entries may
+            be stale (too high); refresh them as they reach the top. */
+        while (nheap > 0)
+        {
+            double myval = SMOOTH(histo, heap[0].h_index);
+            if (myval == heap[0].h_val)
+                break;
+            if (myval > 0)
+                heap[0].h_val = myval;
+            else heap[0] = heap[--nheap];
+            heap_down(heap, nheap, 0);
+        }
+        if (nheap <= 0)
+            break;
+        bestval = heap[0].h_val;
+        bestindex = heap[0].h_index;
+        /* post("bestindex %d, bestval %f, sum %f, minfrac %f",
+            bestindex, bestval, sum, minfrac); */
+        if (bestval < minfrac * sum)
+            break;
+        if (bestindex & 1)
+        {
+            if (histo[bestindex] > histo[bestindex+2])
+                 out = bestindex/2;
+            else out = bestindex/2+1;
+        }
+        else out = bestindex/2;
+        histo[bestindex] = histo[bestindex+1] = histo[bestindex+2] = 0;
+        heap[0] = heap[--nheap];
+        heap_down(heap, nheap, 0);
+        SETFLOAT(argv+argc, out);
+    }
+    return (argc);
+}
@@ -0,0 +1,218 @@
+/* histodog~ -- like histodog, but taking pitch and weight as signals
+straight from a pitch tracker, so that no messages need pass per block.
+
+Every sample with positive weight goes into a histogram which decays
+exponentially with the time constant given by the first argument (msec).
+The decay is applied once per DSP block, and lazily as in histodog, by
+scaling up the new weights.  Every so often (second argument, msec) the
+strongest pitches are found and sent out as a list, and optionally written
+into an array; this only happens if something came in since last time. */
+
+#include "m_pd.h"
+#include "../histodog/histodog.h"
+#include <math.h>
+
+static t_class *histodog_tilde_class;
+
+#define DEFMEMORY 1000
+#define DEFRATE 100
+#define DEFMAXOUT 3
+#define DEFMINFRAC 0.05
+
+typedef struct _histodog_tilde
+{
+    t_object x_obj;
+    t_float x_f;                /* for signal inlet */
+    t_outlet *x_outlet;
+    t_clock *x_clock;
+    double x_histo[NBIN];
+    double x_sum;
+    double x_gain;              /* current scaling of new weights */
+    double x_blockdecay;        /* decay factor per DSP block */
+    t_float x_memory;           /* decay time constant in msec */
+    t_float x_rate;             /* msec between outputs, or 0 for none */
+    t_float x_sr;               /* sample rate and block size from dsp */
+    int x_n;
+    int x_maxout;
+    t_float x_minfrac;
+    int x_dirty;                /* true if new input since last output */
+    t_symbol *x_arrayname;      /* array to write pitches to, if any */
+} t_histodog_tilde;
+
+static void histodog_tilde_renormalize(t_histodog_tilde *x)
+{
+    double scale = 1./x->x_gain;
+    int i;
+    x->x_sum *= scale;
+    for (i = 0; i < NBIN; i++)
+        if ((x->x_histo[i] *= scale) < 1e-12 * x->x_sum)
+            x->x_histo[i] = 0;
+    x->x_gain = 1;
+}
+
+static t_int *histodog_tilde_perform(t_int *w)
+{
+    t_histodog_tilde *x = (t_histodog_tilde *)(w[1]);
+    t_sample *pitch = (t_sample *)(w[2]);
+    t_sample *weight = (t_sample *)(w[3]);
+    int n = (int)(w[4]), i;
+    double gain = x->x_gain / x->x_blockdecay, scale = gain / n, sum = 0;
+    for (i = 0; i < n; i++)
+    {
+        t_sample p = pitch[i], wt = weight[i];
+            /* same bins as histodog_bin(), but checking the range first */
+        if (wt > 0 && p >= LOPITCH && p < LOPITCH + NPITCH)
+        {
+            x->x_histo[(int)(2*(p-LOPITCH)) + 1] += wt * scale;
+            sum += wt;
+        }
+    }
+    if (sum > 0)
+        x->x_sum += sum * scale, x->x_dirty = 1;
+    x->x_gain = gain;
+    if (gain > MAXGAIN)
+        histodog_tilde_renormalize(x);
+    return (w+5);
+}
+
+static void histodog_tilde_setdecay(t_histodog_tilde *x)
+{
+    if (x->x_sr > 0 && x->x_n > 0)
+        x->x_blockdecay = exp(-1000. * x->x_n / (x->x_memory * x->x_sr));
+    else x->x_blockdecay = 1;
+}
+
+static void histodog_tilde_dsp(t_histodog_tilde *x, t_signal **sp)
+{
+    x->x_sr = sp[0]->s_sr;
+    x->x_n = sp[0]->s_n;
+    histodog_tilde_setdecay(x);
+    dsp_add(histodog_tilde_perform, 4, x,
+        sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+}
+
+static void histodog_tilde_bang(t_histodog_tilde *x)
+{
+    double histo[NBIN];
+    t_atom argv[MAXOUT];
+    int i, argc;
+    for (i = 0; i < NBIN; i++)
+        histo[i] = x->x_histo[i];
+    argc = histodog_pick(histo, x->x_sum, x->x_maxout, x->x_minfrac, argv);
+    x->x_dirty = 0;
+    if (*x->x_arrayname->s_name)
+    {
+        t_garray *a;
+        t_word *vec;
+        int npoints;
+        if (!(a = (t_garray *)pd_findbyclass(x->x_arrayname, garray_class)))
+            pd_error(x, "histodog~: %s: no such array",
+                x->x_arrayname->s_name);
+        else if (!garray_getfloatwords(a, &npoints, &vec))
+            pd_error(x, "%s: bad template for histodog~",
+                x->x_arrayname->s_name);
+        else
+        {
+                /* unused slots (up to the number asked for) are zeroed */
+            for (i = 0; i < npoints && i < x->x_maxout; i++)
+                vec[i].w_float = (i < argc ? atom_getfloat(argv+i) : 0);
+            garray_redraw(a);
+        }
+    }
+    outlet_list(x->x_outlet, &s_list, argc, argv);
+}
+
+static void histodog_tilde_tick(t_histodog_tilde *x)
+{
+    if (x->x_dirty)
+        histodog_tilde_bang(x);
+    if (x->x_rate > 0)
+        clock_delay(x->x_clock, x->x_rate);
+}
+
+static void histodog_tilde_rate(t_histodog_tilde *x, t_floatarg f)
+{
+    x->x_rate = (f > 0 ? (f < 1 ? 1 : f) : 0);
+    if (x->x_rate > 0)
+        clock_delay(x->x_clock, x->x_rate);
+    else clock_unset(x->x_clock);
+}
+
+static void histodog_tilde_memory(t_histodog_tilde *x, t_floatarg f)
+{
+    x->x_memory = (f < 1 ? 1 : f);
+    histodog_tilde_setdecay(x);
+}
+
+    /* how many pitches to output at most, and how strong each must be
+    compared to the whole histogram */
+static void histodog_tilde_top(t_histodog_tilde *x, t_floatarg fmaxout,
+    t_floatarg minfrac)
+{
+    int maxout = fmaxout;
+    if (maxout > MAXOUT)
+        maxout = MAXOUT;
+    if (maxout < 1)
+        maxout = 1;
+    x->x_maxout = maxout;
+    x->x_minfrac = minfrac;
+}
+
+static void histodog_tilde_array(t_histodog_tilde *x, t_symbol *s)
+{
+    x->x_arrayname = s;
+}
+
+static void histodog_tilde_clear(t_histodog_tilde *x)
+{
+    int i;
+    for (i = 0; i < NBIN; i++)
+        x->x_histo[i] = 0;
+    x->x_sum = 0;
+    x->x_gain = 1;
+    x->x_dirty = 0;
+}
+
+static void *histodog_tilde_new(t_floatarg memory, t_floatarg rate)
+{
+    t_histodog_tilde *x = (t_histodog_tilde *)pd_new(histodog_tilde_class);
+    inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+    x->x_outlet = outlet_new(&x->x_obj, &s_list);
+    x->x_clock = clock_new(x, (t_method)histodog_tilde_tick);
+    x->x_f = 0;
+    x->x_sr = 0;
+    x->x_n = 0;
+    x->x_maxout = DEFMAXOUT;
+    x->x_minfrac = DEFMINFRAC;
+    x->x_arrayname = &s_;
+    histodog_tilde_clear(x);
+    histodog_tilde_memory(x, (memory > 0 ? memory : DEFMEMORY));
+    histodog_tilde_rate(x, (rate != 0 ? rate : DEFRATE));
+    return (x);
+}
+
+static void histodog_tilde_free(t_histodog_tilde *x)
+{
+    clock_free(x->x_clock);
+}
+
+void histodog_tilde_setup(void)
+{
+    histodog_tilde_class = class_new(gensym("histodog~"),
+        (t_newmethod)histodog_tilde_new, (t_method)histodog_tilde_free,
+        sizeof(t_histodog_tilde), 0, A_DEFFLOAT, A_DEFFLOAT, 0);
+    CLASS_MAINSIGNALIN(histodog_tilde_class, t_histodog_tilde, x_f);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_dsp,
+        gensym("dsp"), 0);
+    class_addbang(histodog_tilde_class, histodog_tilde_bang);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_rate,
+        gensym("rate"), A_FLOAT, 0);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_memory,
+        gensym("memory"), A_FLOAT, 0);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_top,
+        gensym("top"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_array,
+        gensym("array"), A_DEFSYM, 0);
+    class_addmethod(histodog_tilde_class, (t_method)histodog_tilde_clear,
+        gensym("clear"), 0);
+}
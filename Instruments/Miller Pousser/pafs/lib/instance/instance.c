@@ -0,0 +1,63 @@
+/* instance -- state an external keeps for each Pd instance.  See instance.h. */
+
+#include "m_pd.h"
+#include "instance.h"
+#include <pthread.h>
+
+    /* each key keeps a list of copies, one per instance that has asked */
+typedef struct _instanceslot
+{
+    void *s_owner;
+    void *s_data;
+    struct _instanceslot *s_next;
+} t_instanceslot;
+
+void *(*instance_hook)(void);
+static pthread_mutex_t instance_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *instance_current(void)
+{
+    if (instance_hook)
+        return ((*instance_hook)());
+#ifdef PDINSTANCE
+    return (pd_this);
+#else
+    return (0);
+#endif
+}
+
+void *instance_get(t_instancekey *key)
+{
+    void *owner = instance_current();
+    t_instanceslot *s;
+    pthread_mutex_lock(&instance_mutex);
+    for (s = key->k_slots; s; s = s->s_next)
+        if (s->s_owner == owner)
+            break;
+    if (!s)
+    {
+        s = (t_instanceslot *)getbytes(sizeof(*s));
+        s->s_owner = owner;
+        s->s_data = getbytes(key->k_size);
+        s->s_next = key->k_slots;
+        key->k_slots = s;
+    }
+    pthread_mutex_unlock(&instance_mutex);
+    return (s->s_data);
+}
+
+    /* the same sequence pitchcenter~ always used, now one per instance */
+typedef struct _seedstate
+{
+    unsigned int s_seed;
+} t_seedstate;
+
+static t_instancekey instance_seedkey = INSTANCE_KEY(t_seedstate);
+
+unsigned int instance_seed(void)
+{
+    t_seedstate *s = (t_seedstate *)instance_get(&instance_seedkey);
+    if (!s->s_seed)
+        s->s_seed = 307;
+    return (s->s_seed *= 1319);
+}
@@ -0,0 +1,45 @@
+/* instance -- state an external keeps for each Pd instance.
+
+A program can run several instances of Pd at once, each in a thread of its
+own (as libpd allows when compiled with PDINSTANCE).  Symbols, bindings and
+clocks then belong to one instance, so anything an external keeps in a
+static variable that holds or depends on them has to be kept per instance
+instead.  Class pointers needn't be: classes are shared by all instances
+and the setup routines are called once.
+
+Declare a structure for the state and a key for it,
+
+    static t_instancekey foo_key = INSTANCE_KEY(t_foostate);
+
+and get the current instance's copy, zeroed the first time, with
+
+    t_foostate *s = (t_foostate *)instance_get(&foo_key);
+
+The copies are never freed since Pd doesn't tell externals when an
+instance goes away; keep them small. */
+
+#ifndef __INSTANCE_H__
+#define __INSTANCE_H__
+
+typedef struct _instancekey
+{
+    size_t k_size;
+    struct _instanceslot *k_slots;
+} t_instancekey;
+
+#define INSTANCE_KEY(type) {sizeof(type), 0}
+
+void *instance_get(t_instancekey *key);
+
+    /* a seed for a new object's random number generator.  Each instance
+    gives out the same sequence, so that a patch makes the same random
+    choices whichever instance it runs in and whatever the others do. */
+unsigned int instance_seed(void);
+
+    /* a host other than Pd (../bench/stress.c for instance) can set this to
+    a function returning something that identifies the current instance.
+    Otherwise it's Pd's pd_this if compiled with PDINSTANCE, and there's
+    only one instance if not. */
+extern void *(*instance_hook)(void);
+
+#endif /* __INSTANCE_H__ */
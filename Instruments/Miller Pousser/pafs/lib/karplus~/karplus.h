@@ -0,0 +1,27 @@
+/* definitions shared by karplus~ and its inner loop, strings.c */
+
+#define KARPLUS_LANES 16        /* strings are allocated in groups of this */
+
+    /* The delay lines are interleaved: sample number "pos" of string "i" is
+    k_buf[pos * k_stride + i].  Each sample period writes one row, so the
+    strings' inputs are adjacent and can be computed together; only the
+    reads, which are at different delays for each string, are scattered.
+    The per-string arrays have k_stride entries; those past k_n stay zero
+    so that the output can be summed a whole group at a time. */
+typedef struct _karplusbank
+{
+    int k_n;                    /* number of strings */
+    int k_stride;               /* k_n rounded up to KARPLUS_LANES */
+    int k_nrow;                 /* rows in k_buf (a power of two) */
+    int k_phase;                /* row to write next */
+    t_sample *k_buf;
+    int *k_delay;               /* whole samples of delay, at least 1 */
+    t_sample *k_coef;           /* allpass coefficient for the fraction */
+    t_sample *k_apin;           /* allpass's previous input and output */
+    t_sample *k_apout;
+    unsigned int *k_noise;      /* noise generator state */
+    int *k_burst;               /* samples of excitation left */
+    t_sample *k_burstgain;      /* amplitude per sample left */
+    t_sample k_feedback;        /* loop gain */
+    t_sample k_stretch;         /* weight of older sample in lowpass */
+} t_karplusbank;
@@ -0,0 +1,282 @@
+#include "m_pd.h"
+#include "../profile/profile.h"
+#include "../cpu/cpu.h"
+#include "../instance/instance.h"
+#include "karplus.h"
+
+/* karplus~ -- a bank of plucked strings by the Karplus-Strong method, all
+computed in one perform routine.
+
+"pluck <string> <frequency> [<amplitude>]" tunes one of the strings
+(numbered from 1, as "poly" numbers its voices) and excites it with a burst
+of noise; "tune <string> <frequency>" retunes it without plucking it.  Each
+string is a delay line fed back through the averaging lowpass filter of the
+original method and an allpass filter for the fraction of a sample the
+delay line can't give, so that the strings are in tune at any pitch.
+"stretch" is the weight of the older of the two samples averaged (0.5
+averages them; smaller values ring brighter and longer), "feedback" the
+gain around the loop (0.995 by default, and less than 1 in size: the
+lowpass passes DC, so anything steady at the input would otherwise build
+up without bound), and "burst" the length of the noise burst in
+milliseconds, or one period of the string if 0 (the default).  The
+signal inlet excites all the strings; "clear" silences them.
+
+The arguments are the number of strings (8 by default) and the lowest
+frequency (20 Hz by default, and no lower than 1 Hz), which sets the
+length of the delay lines. */
+
+#define KARPLUS_DEFSTRINGS 8
+#define KARPLUS_DEFLOWFREQ 20
+#define KARPLUS_MINLOWFREQ 1    /* keeps the delay lines' size in bounds */
+#define KARPLUS_MAXROWS (1 << 20)   /* ... even at high sample rates */
+#define KARPLUS_MAXSTRINGS 1024
+#define KARPLUS_DEFFEEDBACK 0.995
+#define KARPLUS_MAXFEEDBACK 0.999   /* gain at DC at most 1/(1-this) */
+
+static t_class *karplus_tilde_class;
+
+typedef struct _karplus_tilde
+{
+    t_object x_obj;
+    t_float x_f;                /* for signal inlet */
+    t_karplusbank x_bank;
+    t_float *x_freq;            /* frequency of each string */
+    t_float x_lowfreq;          /* lowest frequency delay lines can take */
+    t_float x_sr;               /* sample rate delay lines are made for */
+    t_float x_burstms;          /* length of excitation, 0 for a period */
+    PROFILE_FIELD
+} t_karplus_tilde;
+
+    /* the inner loop, compiled for each instruction set in strings.c */
+typedef void t_stringsfn(t_karplusbank *x, t_sample *in, t_sample *out,
+    int n);
+CPU_DECLARE(t_stringsfn, karplus_strings);
+static t_stringsfn *karplus_tilde_strings;
+
+    /* set the delay and allpass coefficient that make the loop, including
+    the lowpass's delay of "stretch" samples, one period long.  The
+    allpass is kept between 0.1 and 1.1 samples, where its delay is
+    nearly constant over the frequencies that matter. */
+static void karplus_tilde_dotune(t_karplus_tilde *x, int i)
+{
+    t_karplusbank *b = &x->x_bank;
+    t_float freq = x->x_freq[i], period;
+    int delay;
+    if (freq < x->x_lowfreq)
+        freq = x->x_lowfreq;
+    period = x->x_sr / freq - b->k_stretch;
+    if (period < 1.1)
+        period = 1.1;
+    else if (period > b->k_nrow - 2)
+        period = b->k_nrow - 2;
+    delay = period - 0.1;
+    b->k_delay[i] = delay;
+    b->k_coef[i] = (1 - (period - delay)) / (1 + (period - delay));
+}
+
+    /* make delay lines long enough for the lowest frequency at sample rate
+    "sr".  This is done when the object is made and again if the sample
+    rate changes, which silences the strings. */
+static void karplus_tilde_setsr(t_karplus_tilde *x, t_float sr)
+{
+    t_karplusbank *b = &x->x_bank;
+    int nrow, i;
+    if (sr <= 0)
+        sr = 44100;
+    for (nrow = 4; nrow < sr / x->x_lowfreq + 3 && nrow < KARPLUS_MAXROWS;
+        nrow *= 2)
+        ;
+    if (b->k_buf)
+        freebytes(b->k_buf,
+            (size_t)b->k_nrow * b->k_stride * sizeof(t_sample));
+    b->k_buf = (t_sample *)getbytes(
+        (size_t)nrow * b->k_stride * sizeof(t_sample));
+    b->k_nrow = nrow;
+    b->k_phase = 0;
+    x->x_sr = sr;
+    for (i = 0; i < b->k_n; i++)
+    {
+        b->k_apin[i] = b->k_apout[i] = 0;
+        b->k_burst[i] = 0;
+        karplus_tilde_dotune(x, i);
+    }
+}
+
+static int karplus_tilde_string(t_karplus_tilde *x, t_floatarg f)
+{
+    int i = f;
+    if (i < 1 || i > x->x_bank.k_n)
+    {
+        pd_error(x, "karplus~: string %d out of range 1-%d", i,
+            x->x_bank.k_n);
+        return (-1);
+    }
+    return (i - 1);
+}
+
+static void karplus_tilde_tune(t_karplus_tilde *x, t_floatarg string,
+    t_floatarg freq)
+{
+    int i = karplus_tilde_string(x, string);
+    if (i < 0)
+        return;
+    x->x_freq[i] = freq;
+    karplus_tilde_dotune(x, i);
+}
+
+static void karplus_tilde_pluck(t_karplus_tilde *x, t_symbol *s, int argc,
+    t_atom *argv)
+{
+    t_karplusbank *b = &x->x_bank;
+    t_float amp = (argc > 2 ? atom_getfloat(argv + 2) : 1);
+    int i = karplus_tilde_string(x, atom_getfloatarg(0, argc, argv)), len;
+    if (i < 0)
+        return;
+    x->x_freq[i] = atom_getfloatarg(1, argc, argv);
+    karplus_tilde_dotune(x, i);
+    if (x->x_burstms > 0)
+        len = x->x_burstms * 0.001 * x->x_sr + 0.5;
+    else len = b->k_delay[i] + 1;
+    if (len < 1)
+        len = 1;
+    b->k_burst[i] = len;
+    b->k_burstgain[i] = amp / len;
+}
+
+static void karplus_tilde_stretch(t_karplus_tilde *x, t_floatarg f)
+{
+    int i;
+    x->x_bank.k_stretch = (f < 0 ? 0 : (f > 1 ? 1 : f));
+    for (i = 0; i < x->x_bank.k_n; i++)
+        karplus_tilde_dotune(x, i);
+}
+
+static void karplus_tilde_feedback(t_karplus_tilde *x, t_floatarg f)
+{
+    x->x_bank.k_feedback = (f < -KARPLUS_MAXFEEDBACK ? -KARPLUS_MAXFEEDBACK :
+        (f > KARPLUS_MAXFEEDBACK ? KARPLUS_MAXFEEDBACK : f));
+}
+
+static void karplus_tilde_burst(t_karplus_tilde *x, t_floatarg f)
+{
+    x->x_burstms = (f < 0 ? 0 : f);
+}
+
+static void karplus_tilde_clear(t_karplus_tilde *x)
+{
+    karplus_tilde_setsr(x, x->x_sr);
+}
+
+static t_int *karplus_tilde_perform(t_int *w)
+{
+    t_karplus_tilde *x = (t_karplus_tilde *)(w[1]);
+    t_sample *in = (t_sample *)(w[2]);
+    t_sample *out = (t_sample *)(w[3]);
+    int n = (int)(w[4]);
+    PROFILE_BEGIN;
+    (*karplus_tilde_strings)(&x->x_bank, in, out, n);
+    PROFILE_END(&x->x_profile, 0);
+    return (w+5);
+}
+
+static void karplus_tilde_dsp(t_karplus_tilde *x, t_signal **sp)
+{
+    if (sp[0]->s_sr != x->x_sr)
+        karplus_tilde_setsr(x, sp[0]->s_sr);
+    dsp_add(karplus_tilde_perform, 4, x,
+        sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+}
+
+static void karplus_tilde_stats(t_karplus_tilde *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "karplus~", s);
+}
+
+static void *karplus_tilde_new(t_floatarg nstrings, t_floatarg lowfreq)
+{
+    t_karplus_tilde *x = (t_karplus_tilde *)pd_new(karplus_tilde_class);
+    t_karplusbank *b = &x->x_bank;
+    int n = nstrings, stride, i;
+    if (n < 1)
+        n = KARPLUS_DEFSTRINGS;
+    else if (n > KARPLUS_MAXSTRINGS)
+    {
+        pd_error(x, "karplus~: %d strings: limited to %d", n,
+            KARPLUS_MAXSTRINGS);
+        n = KARPLUS_MAXSTRINGS;
+    }
+    stride = (n + KARPLUS_LANES - 1) / KARPLUS_LANES * KARPLUS_LANES;
+    outlet_new(&x->x_obj, &s_signal);
+    x->x_f = 0;
+    if (lowfreq <= 0)
+        lowfreq = KARPLUS_DEFLOWFREQ;
+    else if (lowfreq < KARPLUS_MINLOWFREQ)
+    {
+        pd_error(x, "karplus~: lowest frequency %g: limited to %d Hz",
+            lowfreq, KARPLUS_MINLOWFREQ);
+        lowfreq = KARPLUS_MINLOWFREQ;
+    }
+    x->x_lowfreq = lowfreq;
+    x->x_burstms = 0;
+    b->k_n = n;
+    b->k_stride = stride;
+    b->k_buf = 0;
+    b->k_nrow = 0;
+    b->k_delay = (int *)getbytes(stride * sizeof(int));
+    b->k_coef = (t_sample *)getbytes(stride * sizeof(t_sample));
+    b->k_apin = (t_sample *)getbytes(stride * sizeof(t_sample));
+    b->k_apout = (t_sample *)getbytes(stride * sizeof(t_sample));
+    b->k_noise = (unsigned int *)getbytes(stride * sizeof(unsigned int));
+    b->k_burst = (int *)getbytes(stride * sizeof(int));
+    b->k_burstgain = (t_sample *)getbytes(stride * sizeof(t_sample));
+    b->k_feedback = KARPLUS_DEFFEEDBACK;
+    b->k_stretch = 0.5;
+    x->x_freq = (t_float *)getbytes(n * sizeof(t_float));
+    for (i = 0; i < n; i++)
+    {
+        b->k_noise[i] = instance_seed();
+        x->x_freq[i] = 440;
+    }
+    karplus_tilde_setsr(x, sys_getsr());
+    PROFILE_INIT(&x->x_profile, "perform");
+    return (x);
+}
+
+static void karplus_tilde_free(t_karplus_tilde *x)
+{
+    t_karplusbank *b = &x->x_bank;
+    freebytes(b->k_buf, (size_t)b->k_nrow * b->k_stride * sizeof(t_sample));
+    freebytes(b->k_delay, b->k_stride * sizeof(int));
+    freebytes(b->k_coef, b->k_stride * sizeof(t_sample));
+    freebytes(b->k_apin, b->k_stride * sizeof(t_sample));
+    freebytes(b->k_apout, b->k_stride * sizeof(t_sample));
+    freebytes(b->k_noise, b->k_stride * sizeof(unsigned int));
+    freebytes(b->k_burst, b->k_stride * sizeof(int));
+    freebytes(b->k_burstgain, b->k_stride * sizeof(t_sample));
+    freebytes(x->x_freq, b->k_n * sizeof(t_float));
+}
+
+void karplus_tilde_setup(void)
+{
+    karplus_tilde_class = class_new(gensym("karplus~"),
+        (t_newmethod)karplus_tilde_new, (t_method)karplus_tilde_free,
+        sizeof(t_karplus_tilde), 0, A_DEFFLOAT, A_DEFFLOAT, 0);
+    CLASS_MAINSIGNALIN(karplus_tilde_class, t_karplus_tilde, x_f);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_dsp,
+        gensym("dsp"), 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_pluck,
+        gensym("pluck"), A_GIMME, 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_tune,
+        gensym("tune"), A_FLOAT, A_FLOAT, 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_stretch,
+        gensym("stretch"), A_FLOAT, 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_feedback,
+        gensym("feedback"), A_FLOAT, 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_burst,
+        gensym("burst"), A_FLOAT, 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_clear,
+        gensym("clear"), 0);
+    class_addmethod(karplus_tilde_class, (t_method)karplus_tilde_stats,
+        gensym("stats"), A_DEFSYM, 0);
+    karplus_tilde_strings = CPU_PICK(karplus_strings);
+}
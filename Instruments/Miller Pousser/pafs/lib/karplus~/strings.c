@@ -0,0 +1,71 @@
+/* the inner loop of karplus~, compiled once for each instruction set (see
+../cpu/cpu.h).  For each sample, every string reads its delay line at its
+delay and one sample further back, mixes the two by the "stretch" weight
+(the averaging lowpass), corrects the tuning with a first-order allpass,
+scales that by the loop gain, and adds its excitation and the input.  The
+strings are independent, so the compiler does a vector of them at once,
+gathering the reads; the row written is contiguous.  The pointers are
+"restrict" since the compiler won't otherwise gather; the row being
+written is never one of those read, since delays are at least one sample
+and shorter than the delay line.  The strings are then summed in a fixed
+order, a group of KARPLUS_LANES at a time, so that every version of the
+kernel gives exactly the same output. */
+
+#include "m_pd.h"
+#include "../cpu/cpu.h"
+#include "karplus.h"
+
+static inline void strings_row(const t_sample *restrict buf,
+    t_sample *restrict row, int n, int stride, int phase, int mask,
+    const int *restrict delay, const t_sample *restrict coef,
+    t_sample *restrict apin, t_sample *restrict apout,
+    unsigned int *restrict noise, int *restrict burst,
+    const t_sample *restrict burstgain, t_sample feedback,
+    t_sample stretch, t_sample input)
+{
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        int back = phase - delay[i];
+        int ia = (back & mask) * stride + i;
+        int ib = ((back - 1) & mask) * stride + i;
+        t_sample a = buf[ia], b = buf[ib], lp, ap, exc;
+        unsigned int state = noise[i] * 435898247 + 382842987;
+        int left = burst[i];
+
+        lp = a + stretch * (b - a);
+        ap = apin[i] + coef[i] * (lp - apout[i]);
+        apin[i] = lp;
+        apout[i] = ap;
+            /* same generator as noise~, but signed: -1 to 1 */
+        exc = (int)state * (1.f / 2147483648.f) * (left * burstgain[i]);
+        noise[i] = state;
+        burst[i] = left - (left > 0);
+        row[i] = feedback * ap + exc + input;
+    }
+}
+
+void CPU_KERNEL(karplus_strings)(t_karplusbank *x, t_sample *in,
+    t_sample *out, int n)
+{
+    int stride = x->k_stride, mask = x->k_nrow - 1, phase = x->k_phase;
+    int i, j, k, width;
+    for (i = 0; i < n; i++)
+    {
+        t_sample *row = x->k_buf + phase * stride, acc[KARPLUS_LANES];
+        strings_row(x->k_buf, row, x->k_n, stride, phase, mask,
+            x->k_delay, x->k_coef, x->k_apin, x->k_apout, x->k_noise,
+            x->k_burst, x->k_burstgain, x->k_feedback, x->k_stretch, in[i]);
+        for (j = 0; j < KARPLUS_LANES; j++)
+            acc[j] = row[j];
+        for (k = KARPLUS_LANES; k < stride; k += KARPLUS_LANES)
+            for (j = 0; j < KARPLUS_LANES; j++)
+                acc[j] += row[k + j];
+        for (width = KARPLUS_LANES/2; width; width >>= 1)
+            for (j = 0; j < width; j++)
+                acc[j] += acc[j + width];
+        out[i] = acc[0];
+        phase = (phase + 1) & mask;
+    }
+    x->k_phase = phase;
+}
@@ -0,0 +1,36 @@
+/* pafs -- every class in this directory as a single library, built by the
+makefile here.  Start Pd with "-lib pafs" (or put [declare -lib pafs] in a
+patch) and all the objects below are available at once.  The DSP kernels
+are picked for this machine's instruction set as each class is set up (see
+cpu/cpu.h); the choice is posted here. */
+
+#include "m_pd.h"
+#include "cpu/cpu.h"
+
+void dog_setup(void);
+void histodog_setup(void);
+void histodog_tilde_setup(void);
+void karplus_tilde_setup(void);
+void peaktracker_setup(void);
+void pitchcenter_setup(void);
+void pitchcenter_tilde_setup(void);
+void smerdyakov_setup(void);
+void system_setup(void);
+void tabreadwrap4_tilde_setup(void);
+void text_setup(void);
+
+void pafs_setup(void)
+{
+    dog_setup();
+    histodog_setup();
+    histodog_tilde_setup();
+    karplus_tilde_setup();
+    peaktracker_setup();
+    pitchcenter_setup();
+    pitchcenter_tilde_setup();
+    smerdyakov_setup();
+    system_setup();
+    tabreadwrap4_tilde_setup();
+    text_setup();
+    post("pafs: DSP kernels for %s", cpu_levelname(cpu_level()));
+}
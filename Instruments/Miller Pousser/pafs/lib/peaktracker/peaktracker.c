@@ -11,6 +11,7 @@ Available under the BSD license (see "LICENCE.txt" in this distribution.)
 #include <stdio.h>
 #include <string.h> */
 #include <math.h>
+#include "../profile/profile.h"
 
 #define MAXDIM 100
 #define DEFAULTDIM 10
@@ -46,6 +47,7 @@ typedef struct _peaktracker
     float x_inter1value;    /* value to add for partials within an interval */
     float x_inter1tones;    /* halftones in the interval */
     float x_inter1tolerance;/* tolerance in cents for the interval */
+    PROFILE_FIELD
 } t_peaktracker;
 
 static t_class *peaktracker_class;
@@ -111,6 +113,7 @@ static void peaktracker_snapshot(t_peaktracker *x)
     int i, j;
     float lopit = ftom(x->x_preferlofreq);
     float hipit = ftom(x->x_preferhifreq);
+    PROFILE_BEGIN;
     for (i = 0; i < x->x_gotnew; i++)
     {
         float pit = ftom(x->x_peakin[i].p_freq);
@@ -183,6 +186,7 @@ static void peaktracker_snapshot(t_peaktracker *x)
         x->x_peakout[j].p_age = 0;
     }
     peaktracker_spit(x);
+    PROFILE_END(&x->x_profile, 1);
 }
 
 
@@ -197,6 +201,7 @@ static void peaktracker_doit(t_peaktracker *x)
     int i, j;
     float lopit = ftom(x->x_preferlofreq);
     float hipit = ftom(x->x_preferhifreq);
+    PROFILE_BEGIN;
     for (j = 0; j < x->x_ntracks; j++)
     {
     }
@@ -308,6 +313,7 @@ static void peaktracker_doit(t_peaktracker *x)
     }
     peaktracker_spit(x);
     x->x_gotnew = 0;
+    PROFILE_END(&x->x_profile, 0);
 }
 
 static void peaktracker_slewhz(t_peaktracker *x, t_float f)
@@ -388,6 +394,11 @@ static void peaktracker_print(t_peaktracker *x)
     	x->x_inter1value, x->x_inter1tones, x->x_inter1tolerance);
 }
 
+static void peaktracker_stats(t_peaktracker *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "peaktracker", s);
+}
+
 static void peaktracker_free(t_peaktracker *x)
 {
     freebytes(x->x_peakin, x->x_dim * sizeof(t_peak));
@@ -413,6 +424,7 @@ static void *peaktracker_new(t_symbol *s, t_floatarg dim)
     x->x_inter1value = 0;
     x->x_inter1tones = 0;
     x->x_inter1tolerance = 1;
+    PROFILE_INIT(&x->x_profile, "doit", "snapshot");
     return (x);
 }
 
@@ -429,6 +441,8 @@ void peaktracker_setup(void)
         gensym("doit"), 0);
     class_addmethod(peaktracker_class, (t_method)peaktracker_print,
         gensym("print"), 0);
+    class_addmethod(peaktracker_class, (t_method)peaktracker_stats,
+        gensym("stats"), A_DEFSYM, 0);
     class_addlist(peaktracker_class, peaktracker_list);
     class_addmethod(peaktracker_class, (t_method)peaktracker_clear,
         gensym("clear"), 0);
@@ -1,17 +1,32 @@
 #include "m_pd.h"
 #include <stdlib.h>
+#include <math.h>
+#include "../instance/instance.h"
 
 /* pitchcenter -- pitchcenter incoming numbers toward a given set of numbers */
 
+/* The set is kept sorted so that the nearest member can be found by binary
+search.  In "fold" mode the set is instead taken as pitch classes (modulo
+12) and the nearest one is looked up, to the nearest cent, in a table made
+when the set changes.  Members of the set a little further off than
+"tolerance" are snapped to at random; each instance has its own random
+number generator, which the "seed" message resets. */
+
 static t_class *pitchcenter_class;
 
+#define NCENTS 1200     /* size of octave-folded lookup table */
+
 typedef struct _pitchcenter
 {
     t_object x_obj;
     t_outlet *x_outlet;
     int x_n;
-    t_float *x_vec;
+    t_float *x_vec;     /* sorted */
     float x_tolerance;
+    int x_fold;         /* true to fold into one octave */
+    t_float *x_foldtab; /* nearest pitch class for each cent, or 0 */
+    int x_verbose;
+    unsigned int x_state;       /* random number generator state */
 } t_pitchcenter;
 
 static void *pitchcenter_new(void)
@@ -21,34 +36,100 @@ static void *pitchcenter_new(void)
     x->x_n = 0;
     x->x_vec = (t_float *)getbytes(0);
     x->x_tolerance = 0;
+    x->x_fold = 0;
+    x->x_foldtab = 0;
+    x->x_verbose = 0;
+    x->x_state = instance_seed();
     return (x);
 }
 
+    /* nearest member of the (sorted, nonempty) set */
+static t_float pitchcenter_nearest(t_pitchcenter *x, t_float f)
+{
+    int lo = 0, hi = x->x_n;
+    while (lo < hi)     /* find first member >= f */
+    {
+        int mid = (lo + hi) >> 1;
+        if (x->x_vec[mid] < f)
+            lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == x->x_n)
+        return (x->x_vec[lo-1]);
+    else if (lo > 0 && f - x->x_vec[lo-1] <= x->x_vec[lo] - f)
+        return (x->x_vec[lo-1]);
+    else return (x->x_vec[lo]);
+}
+
+    /* make the table for fold mode.  Entries are pitch classes moved by
+    an octave if need be to lie nearest the cent in question, so they may
+    fall a little outside 0-12. */
+static void pitchcenter_makefold(t_pitchcenter *x)
+{
+    int i, j;
+    if (!x->x_foldtab)
+        x->x_foldtab = (t_float *)getbytes(NCENTS * sizeof(t_float));
+    for (i = 0; i < NCENTS; i++)
+    {
+        t_float pit = i * 0.01, best = 0, besterror = 1e10;
+        for (j = 0; j < x->x_n; j++)
+        {
+            t_float pc = x->x_vec[j] - 12 * floor(x->x_vec[j] / 12.), err;
+            if (pc - pit > 6)
+                pc -= 12;
+            else if (pit - pc > 6)
+                pc += 12;
+            err = (pc > pit ? pc - pit : pit - pc);
+            if (err < besterror)
+                besterror = err, best = pc;
+        }
+        x->x_foldtab[i] = best;
+    }
+}
+
 static void pitchcenter_float(t_pitchcenter *x, t_floatarg f)
 {
-    int i, bestindex = -1;
-    float besterror = 1e10;
-    for (i = 0; i < x->x_n; i++)
+    float besterror, target;
+    if (!x->x_n)
+    {
+        outlet_float(x->x_outlet, f);
+        return;
+    }
+    if (x->x_fold)
     {
-        float thiserror = (f < x->x_vec[i] ? x->x_vec[i] - f :
-            f - x->x_vec[i]);
-        if (thiserror < besterror)
-            besterror = thiserror, bestindex = i;
+        t_float octave = 12 * floor(f / 12.);
+        double fcent = (f - octave) * 100 + 0.5;
+        int cent;
+            /* infinities, NaNs and numbers too big to fold accurately
+            pass through; the comparison is false for NaN */
+        if (!(fcent >= 0 && fcent < NCENTS + 1))
+        {
+            outlet_float(x->x_outlet, f);
+            return;
+        }
+        cent = fcent;
+        if (cent >= NCENTS)
+            cent -= NCENTS, octave += 12;
+        target = octave + x->x_foldtab[cent];
     }
+    else target = pitchcenter_nearest(x, f);
+    besterror = (f < target ? target - f : f - target);
     besterror -= x->x_tolerance;
-    post("besterr %f", besterror);
+    if (x->x_verbose)
+        post("besterr %f", besterror);
     if (besterror < 0)
         goto bash;
     else if (besterror < 1)
     {
-        int r = random();
-        if (r < RAND_MAX * (1-besterror))
+            /* same generator as pitchcenter~ */
+        x->x_state = x->x_state * 435898247 + 382842987;
+        if ((x->x_state & 0x7fffffff) * (1./2147483648.) < 1-besterror)
             goto bash;
     }
     outlet_float(x->x_outlet, f);
     return;
 bash:
-    outlet_float(x->x_outlet, x->x_vec[bestindex]);
+    outlet_float(x->x_outlet, target);
 }
 
 static void pitchcenter_tolerance(t_pitchcenter *x, t_floatarg f)
@@ -56,20 +137,47 @@ static void pitchcenter_tolerance(t_pitchcenter *x, t_floatarg f)
     x->x_tolerance = f;
 }
 
+static int pitchcenter_compare(const void *p1, const void *p2)
+{
+    t_float f1 = *(t_float *)p1, f2 = *(t_float *)p2;
+    return (f1 < f2 ? -1 : (f1 > f2 ? 1 : 0));
+}
+
 static void pitchcenter_set(t_pitchcenter *x, t_symbol *s, int argc,
     t_atom *argv)
 {
     int i;
-    x->x_vec = (float *)t_resizebytes(x->x_vec,
+    x->x_vec = (t_float *)t_resizebytes(x->x_vec,
         x->x_n*sizeof(*x->x_vec), argc*sizeof(*x->x_vec));
     for (i = 0; i < argc; i++)
         x->x_vec[i] = atom_getfloat(&argv[i]);
     x->x_n = argc;
+    qsort(x->x_vec, argc, sizeof(*x->x_vec), pitchcenter_compare);
+    if (x->x_fold)
+        pitchcenter_makefold(x);
+}
+
+static void pitchcenter_fold(t_pitchcenter *x, t_floatarg f)
+{
+    if ((x->x_fold = (f != 0)))
+        pitchcenter_makefold(x);
+}
+
+static void pitchcenter_seed(t_pitchcenter *x, t_floatarg f)
+{
+    x->x_state = (unsigned int)f;
+}
+
+static void pitchcenter_verbose(t_pitchcenter *x, t_floatarg f)
+{
+    x->x_verbose = (f != 0);
 }
 
 static void pitchcenter_free(t_pitchcenter *x)
 {
     t_freebytes(x->x_vec, x->x_n * sizeof(*x->x_vec));
+    if (x->x_foldtab)
+        t_freebytes(x->x_foldtab, NCENTS * sizeof(t_float));
 }
 
 
@@ -82,4 +190,10 @@ void pitchcenter_setup(void)
         gensym("set"), A_GIMME, 0);
     class_addmethod(pitchcenter_class, (t_method)pitchcenter_tolerance,
         gensym("tolerance"), A_FLOAT, 0);
+    class_addmethod(pitchcenter_class, (t_method)pitchcenter_fold,
+        gensym("fold"), A_FLOAT, 0);
+    class_addmethod(pitchcenter_class, (t_method)pitchcenter_verbose,
+        gensym("verbose"), A_FLOAT, 0);
+    class_addmethod(pitchcenter_class, (t_method)pitchcenter_seed,
+        gensym("seed"), A_FLOAT, 0);
 }
@@ -0,0 +1,165 @@
+#include "m_pd.h"
+#include <stdlib.h>
+#include "../cpu/cpu.h"
+#include "../instance/instance.h"
+
+/* pitchcenter~ -- like pitchcenter, but pulling a pitch signal toward a
+given set of pitches sample by sample.  Pitches within "tolerance" of a
+member of the set are snapped to it; for the next semitone beyond, they
+are snapped with a probability falling linearly to zero.  Each instance
+has its own random number generator, which the "seed" message resets.
+
+The set is held in a sorted table padded with huge values at either end
+out to a power of two, so that the nearest member can be found by a
+binary search with a fixed number of steps and no data-dependent
+branches.  One more BIGPITCH follows the table, since the search ends on
+the last entry for inputs at or above BIGPITCH and then reads the one
+after it.  The search is done for the whole block first (in search.c,
+where it's vectorized), and then the random numbers are drawn sample by
+sample. */
+
+static t_class *pitchcenter_tilde_class;
+
+#define BIGPITCH 1e30
+
+typedef struct _pitchcenter_tilde
+{
+    t_object x_obj;
+    t_float x_f;                /* for signal inlet */
+    int x_n;                    /* number of pitches in set */
+    int x_tabsize;              /* padded size of table (power of 2) */
+    t_float *x_tab;             /* -BIGPITCH, sorted set, BIGPITCH...,
+                                    and one more BIGPITCH */
+    t_float x_tolerance;
+    unsigned int x_state;       /* random number generator state */
+    t_float *x_target;          /* nearest member for each sample */
+    int x_ntarget;
+} t_pitchcenter_tilde;
+
+    /* the search, compiled for each instruction set in search.c */
+typedef void t_searchfn(t_float *tab, int tabsize, t_sample *in,
+    t_float *target, int n);
+CPU_DECLARE(t_searchfn, pitchcenter_search);
+static t_searchfn *pitchcenter_tilde_search;
+
+static t_int *pitchcenter_tilde_perform(t_int *w)
+{
+    t_pitchcenter_tilde *x = (t_pitchcenter_tilde *)(w[1]);
+    t_sample *in = (t_sample *)(w[2]);
+    t_sample *out = (t_sample *)(w[3]);
+    int n = (int)(w[4]), i;
+    t_float *tab = x->x_tab, *target = x->x_target,
+        tolerance = x->x_tolerance;
+    int tabsize = x->x_tabsize;
+    unsigned int state = x->x_state;
+    if (!x->x_n)
+    {
+        while (n--)
+            *out++ = *in++;
+        return (w+5);
+    }
+    (*pitchcenter_tilde_search)(tab, tabsize, in, target, n);
+    for (i = 0; i < n; i++)
+    {
+        t_sample f = in[i];
+        t_float err = (target[i] > f ? target[i] - f : f - target[i]) -
+            tolerance, r;
+            /* same linear congruential generator as noise~ */
+        state = state * 435898247 + 382842987;
+        r = (state & 0x7fffffff) * (1./2147483648.);
+        out[i] = (r < 1 - err ? target[i] : f);
+    }
+    x->x_state = state;
+    return (w+5);
+}
+
+static void pitchcenter_tilde_dsp(t_pitchcenter_tilde *x, t_signal **sp)
+{
+    if (sp[0]->s_n > x->x_ntarget)
+    {
+        x->x_target = (t_float *)t_resizebytes(x->x_target,
+            x->x_ntarget * sizeof(*x->x_target),
+                sp[0]->s_n * sizeof(*x->x_target));
+        x->x_ntarget = sp[0]->s_n;
+    }
+    dsp_add(pitchcenter_tilde_perform, 4, x,
+        sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+}
+
+static int pitchcenter_tilde_compare(const void *p1, const void *p2)
+{
+    t_float f1 = *(t_float *)p1, f2 = *(t_float *)p2;
+    return (f1 < f2 ? -1 : (f1 > f2 ? 1 : 0));
+}
+
+static void pitchcenter_tilde_set(t_pitchcenter_tilde *x, t_symbol *s,
+    int argc, t_atom *argv)
+{
+    int i, tabsize;
+    for (tabsize = 2; tabsize < argc + 2; tabsize *= 2)
+        ;
+    x->x_tab = (t_float *)t_resizebytes(x->x_tab,
+        (x->x_tabsize + 1) * sizeof(*x->x_tab),
+            (tabsize + 1) * sizeof(*x->x_tab));
+    x->x_tabsize = tabsize;
+    x->x_tab[0] = -BIGPITCH;
+    for (i = 0; i < argc; i++)
+        x->x_tab[i+1] = atom_getfloat(&argv[i]);
+    qsort(x->x_tab + 1, argc, sizeof(*x->x_tab), pitchcenter_tilde_compare);
+    for (i = argc + 1; i < tabsize + 1; i++)
+        x->x_tab[i] = BIGPITCH;
+    x->x_n = argc;
+}
+
+static void pitchcenter_tilde_tolerance(t_pitchcenter_tilde *x,
+    t_floatarg f)
+{
+    x->x_tolerance = f;
+}
+
+static void pitchcenter_tilde_seed(t_pitchcenter_tilde *x, t_floatarg f)
+{
+    x->x_state = (unsigned int)f;
+}
+
+static void *pitchcenter_tilde_new(t_floatarg tolerance)
+{
+    t_pitchcenter_tilde *x = (t_pitchcenter_tilde *)
+        pd_new(pitchcenter_tilde_class);
+    outlet_new(&x->x_obj, &s_signal);
+    x->x_f = 0;
+    x->x_n = 0;
+    x->x_tabsize = 0;
+    x->x_tab = (t_float *)getbytes(sizeof(*x->x_tab));
+    pitchcenter_tilde_set(x, 0, 0, 0);
+    x->x_tolerance = tolerance;
+    x->x_state = instance_seed();
+    x->x_target = 0;
+    x->x_ntarget = 0;
+    return (x);
+}
+
+static void pitchcenter_tilde_free(t_pitchcenter_tilde *x)
+{
+    t_freebytes(x->x_tab, (x->x_tabsize + 1) * sizeof(*x->x_tab));
+    if (x->x_target)
+        t_freebytes(x->x_target, x->x_ntarget * sizeof(*x->x_target));
+}
+
+void pitchcenter_tilde_setup(void)
+{
+    pitchcenter_tilde_class = class_new(gensym("pitchcenter~"),
+        (t_newmethod)pitchcenter_tilde_new,
+        (t_method)pitchcenter_tilde_free, sizeof(t_pitchcenter_tilde), 0,
+        A_DEFFLOAT, 0);
+    CLASS_MAINSIGNALIN(pitchcenter_tilde_class, t_pitchcenter_tilde, x_f);
+    class_addmethod(pitchcenter_tilde_class, (t_method)pitchcenter_tilde_dsp,
+        gensym("dsp"), 0);
+    class_addmethod(pitchcenter_tilde_class, (t_method)pitchcenter_tilde_set,
+        gensym("set"), A_GIMME, 0);
+    class_addmethod(pitchcenter_tilde_class,
+        (t_method)pitchcenter_tilde_tolerance, gensym("tolerance"), A_FLOAT, 0);
+    class_addmethod(pitchcenter_tilde_class, (t_method)pitchcenter_tilde_seed,
+        gensym("seed"), A_FLOAT, 0);
+    pitchcenter_tilde_search = CPU_PICK(pitchcenter_search);
+}
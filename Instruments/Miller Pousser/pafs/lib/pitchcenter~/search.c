@@ -0,0 +1,37 @@
+/* the table search of pitchcenter~, compiled once for each instruction set
+(see ../cpu/cpu.h).  It finds the nearest member of the set for every
+sample of a block, leaving the random part of the decision to the caller.
+Rather than run the binary search to the end for one sample before
+starting the next, each step of the search is taken for a chunk of
+samples in turn.  Since the table size is a power of two every search
+takes the same steps, so each of those loops is a lookup and a compare
+across the chunk with no branches, which the compiler vectorizes (the
+lookups themselves stay scalar loads).  The results are the same as
+searching sample by sample. */
+
+#include "m_pd.h"
+#include "../cpu/cpu.h"
+
+#define SEARCH_CHUNK 64         /* samples searched together */
+
+void CPU_KERNEL(pitchcenter_search)(t_float *restrict tab, int tabsize,
+    t_sample *restrict in, t_float *restrict target, int n)
+{
+    int base[SEARCH_CHUNK], half, i, m;
+    for (; n > 0; n -= m, in += m, target += m)
+    {
+        m = (n < SEARCH_CHUNK ? n : SEARCH_CHUNK);
+        for (i = 0; i < m; i++)
+            base[i] = 0;
+            /* find the last entry below each input (the first is always
+            below) */
+        for (half = tabsize >> 1; half; half >>= 1)
+            for (i = 0; i < m; i++)
+                base[i] += (tab[base[i] + half] < in[i] ? half : 0);
+        for (i = 0; i < m; i++)
+        {
+            t_float f = in[i], lo = tab[base[i]], hi = tab[base[i] + 1];
+            target[i] = (f - lo <= hi - f ? lo : hi);
+        }
+    }
+}
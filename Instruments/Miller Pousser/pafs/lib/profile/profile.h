@@ -0,0 +1,152 @@
+/* profile -- optional timing of an external's hot entry points.
+
+Compile with -DPROFILE to turn it on.  Each object then keeps, for each
+entry point, the number of calls, total and maximum time, and a histogram
+of times (four bins per octave of nanoseconds) from which percentiles are
+estimated; also a count of allocations made by its own code.  A "stats"
+message posts these, and "stats reset" clears them.  Without -DPROFILE the
+macros below compile to nothing, and "stats" just says so.
+
+In the object's structure put PROFILE_FIELD; in its "new" routine call
+PROFILE_INIT(&x->x_profile, "name1", "name2", ...); time an entry point
+with PROFILE_BEGIN (after its declarations) and PROFILE_END(&x->x_profile,
+n) where n is the entry point's place in the list of names; and answer
+"stats" with PROFILE_STATS(&x->x_profile, "classname", s).  */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#ifdef PROFILE
+
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+
+#define PROFILE_MAXENTRY 4
+#define PROFILE_NBIN 160
+
+typedef struct _profentry
+{
+    char *e_name;
+    long e_ncalls;
+    double e_total;                         /* nsec */
+    double e_max;
+    unsigned int e_histo[PROFILE_NBIN];
+} t_profentry;
+
+typedef struct _profile
+{
+    int p_n;
+    long p_nalloc;
+    t_profentry p_vec[PROFILE_MAXENTRY];
+} t_profile;
+
+static double profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static void profile_reset(t_profile *p)
+{
+    int i;
+    p->p_nalloc = 0;
+    for (i = 0; i < p->p_n; i++)
+    {
+        t_profentry *e = &p->p_vec[i];
+        e->e_ncalls = 0;
+        e->e_total = e->e_max = 0;
+        memset(e->e_histo, 0, sizeof(e->e_histo));
+    }
+}
+
+    /* the names are a null-terminated list */
+static void profile_init(t_profile *p, ...)
+{
+    va_list ap;
+    char *name;
+    va_start(ap, p);
+    for (p->p_n = 0; p->p_n < PROFILE_MAXENTRY &&
+        (name = va_arg(ap, char *)); p->p_n++)
+            p->p_vec[p->p_n].e_name = name;
+    va_end(ap);
+    profile_reset(p);
+}
+
+static void profile_add(t_profile *p, int which, double ns)
+{
+    t_profentry *e = &p->p_vec[which];
+    int bin = 0, exponent;
+    if (ns >= 1)
+    {
+        double mantissa = frexp(ns, &exponent);
+        bin = 4 * (exponent - 1) + (int)(8 * mantissa - 4);
+        if (bin >= PROFILE_NBIN)
+            bin = PROFILE_NBIN - 1;
+    }
+    e->e_histo[bin]++;
+    e->e_ncalls++;
+    e->e_total += ns;
+    if (ns > e->e_max)
+        e->e_max = ns;
+}
+
+    /* upper edge of the bin the given fraction of calls fall below */
+static double profile_percentile(t_profentry *e, double frac)
+{
+    long want = frac * e->e_ncalls, sofar = 0;
+    int bin;
+    double edge;
+    for (bin = 0; bin < PROFILE_NBIN - 1; bin++)
+        if ((sofar += e->e_histo[bin]) > want)
+            break;
+    edge = ldexp(1 + (bin % 4 + 1) * 0.25, bin / 4);
+    return (edge < e->e_max ? edge : e->e_max);
+}
+
+static void profile_stats(t_profile *p, char *classname, t_symbol *s)
+{
+    int i;
+    if (s && !strcmp(s->s_name, "reset"))
+    {
+        profile_reset(p);
+        return;
+    }
+    for (i = 0; i < p->p_n; i++)
+    {
+        t_profentry *e = &p->p_vec[i];
+        if (!e->e_ncalls)
+            post("%s: %s: no calls", classname, e->e_name);
+        else post("%s: %s: %ld calls, total %.3f ms, mean %.0f ns, "
+            "max %.0f ns, percentiles 50: %.0f 90: %.0f 99: %.0f ns",
+            classname, e->e_name, e->e_ncalls, e->e_total * 1e-6,
+            e->e_total / e->e_ncalls, e->e_max,
+            profile_percentile(e, 0.5), profile_percentile(e, 0.9),
+            profile_percentile(e, 0.99));
+    }
+    post("%s: %ld allocations", classname, p->p_nalloc);
+}
+
+#define PROFILE_FIELD t_profile x_profile;
+#define PROFILE_INIT(p, ...) profile_init((p), __VA_ARGS__, (char *)0)
+#define PROFILE_BEGIN double profile_starttime = profile_now()
+#define PROFILE_END(p, which) \
+    profile_add((p), (which), profile_now() - profile_starttime)
+#define PROFILE_ALLOC(p) ((p)->p_nalloc++)
+#define PROFILE_STATS(p, classname, s) profile_stats((p), (classname), (s))
+
+#else /* PROFILE */
+
+#define PROFILE_FIELD
+#define PROFILE_INIT(p, ...)
+#define PROFILE_BEGIN
+#define PROFILE_END(p, which)
+#define PROFILE_ALLOC(p)
+#define PROFILE_STATS(p, classname, s) \
+    post("%s: compiled without profiling (-DPROFILE)", (classname))
+
+#endif /* PROFILE */
+
+#endif /* __PROFILE_H__ */
@@ -18,12 +18,17 @@ Plays back from one, or a mixture of two, sequences of 'notes'.
 
 The 'resttime' parameter controls the maximum inter-onset interval that will
 be used in playback (transititions with longer ones will be suppressed.)
+
+Each instance has its own random number generator, which the 'seed' message
+resets, so that it makes the same choices whatever else is running.
 */
 
 #include "m_pd.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "../profile/profile.h"
+#include "../instance/instance.h"
 
 typedef struct _element
 {
@@ -74,6 +79,8 @@ typedef struct _smerdyakov
     float x_uniformize;
     int x_norestart;
     float x_tempo;
+    unsigned int x_state;       /* random number generator state */
+    PROFILE_FIELD
 } t_smerdyakov;
 
 static t_class *smerdyakov_class;
@@ -92,6 +99,7 @@ static void smerdyakov_float(t_smerdyakov *x, t_float f)
 	t_element *t;
         x->x_seq = (t_element *)resizebytes(x->x_seq,
             x->x_n * sizeof(t_element), (x->x_n + 1) * sizeof(t_element));
+        PROFILE_ALLOC(&x->x_profile);
 	t = &x->x_seq[x->x_n];
 	t->e_pit = pit;
 	t->e_vel = x->x_vel;
@@ -152,7 +160,14 @@ static void smerdyakov_play(t_smerdyakov *x, t_float f)
     else clock_unset(x->x_clock);
 }
 
-static void smerdyakov_tick(t_smerdyakov *x)
+    /* random number from 0 to 1, by the same generator as pitchcenter~ */
+static float smerdyakov_random(t_smerdyakov *x)
+{
+    x->x_state = x->x_state * 435898247 + 382842987;
+    return ((x->x_state & 0x7fffffff) * (1./2147483648.));
+}
+
+static void smerdyakov_dotick(t_smerdyakov *x)
 {
     int stacksize = 2 * (x->x_dim + 1) * x->x_maxdepth;
     float *stackspace = (float *)alloca(stacksize * sizeof(float));
@@ -228,8 +243,8 @@ static void smerdyakov_tick(t_smerdyakov *x)
                 pvec[e->e_pit] += e->e_prob;
                 probsum[depth] += e->e_prob;
                 pvec += x->x_dim;
-                if (e2->e_pit != e3->e_pit || depth >= (x->x_maxdepth-1)
-                    || depth > i || depth > x->x_playnext)
+                if (depth >= (x->x_maxdepth-1) || depth > i ||
+                    depth > x->x_playnext || e2->e_pit != e3->e_pit)
                         break;
 	        depth++;
             }
@@ -247,7 +262,7 @@ static void smerdyakov_tick(t_smerdyakov *x)
 
     wantdepth = x->x_playdepth;
     fracdepth = x->x_playdepth - wantdepth;
-    if (random() < fracdepth * RAND_MAX)
+    if (smerdyakov_random(x) < fracdepth)
         wantdepth++;
     if (wantdepth >= x->x_maxdepth)
 	wantdepth = x->x_maxdepth-1;
@@ -263,9 +278,8 @@ static void smerdyakov_tick(t_smerdyakov *x)
     	(probsum1[0] + mix * (probsum2[0] - probsum1[0])) <= 0)
             goto restart;
         /* 3. choose new index */
-    randx = random() * (probsum1[wantdepth]
-    	+ mix * (probsum2[wantdepth] - probsum1[wantdepth]))
-	    * (1. / (float)RAND_MAX);
+    randx = smerdyakov_random(x) * (probsum1[wantdepth]
+    	+ mix * (probsum2[wantdepth] - probsum1[wantdepth]));
     for (chainindex = 0; chainindex < nchain; chainindex++)
     {
     	float weight = (chainindex ? mix : 1-mix);
@@ -311,6 +325,13 @@ restart:
     clock_delay(x->x_clock, 500);
 }
 
+static void smerdyakov_tick(t_smerdyakov *x)
+{
+    PROFILE_BEGIN;
+    smerdyakov_dotick(x);
+    PROFILE_END(&x->x_profile, 0);
+}
+
     /* a hack for a specific musical problem.  Suggest from outside
     what the next pitch should be.  This can't be called reentrantly from
     within the tick routine. */
@@ -452,6 +473,16 @@ static void smerdyakov_print(t_smerdyakov *x)
     	x->x_resttime);
 }
 
+static void smerdyakov_stats(t_smerdyakov *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "smerdyakov", s);
+}
+
+static void smerdyakov_seed(t_smerdyakov *x, t_float f)
+{
+    x->x_state = (unsigned int)f;
+}
+
 static void smerdyakov_mix(t_smerdyakov *x, t_symbol *s1, t_symbol *s2,
     t_floatarg f)
 {
@@ -496,6 +527,8 @@ static void *smerdyakov_new(t_symbol *s, t_floatarg dim, t_floatarg depth)
     x->x_mixsym1 = &s_;
     x->x_mixsym2 = &s_;
     x->x_lastusedsym = &s_;
+    x->x_state = instance_seed();
+    PROFILE_INIT(&x->x_profile, "tick");
     return (x);
 }
 
@@ -507,6 +540,8 @@ void smerdyakov_setup(void)
     class_addfloat(smerdyakov_class, smerdyakov_float);
     class_addmethod(smerdyakov_class, (t_method)smerdyakov_print,
         gensym("print"), 0);
+    class_addmethod(smerdyakov_class, (t_method)smerdyakov_stats,
+        gensym("stats"), A_DEFSYM, 0);
     class_addmethod(smerdyakov_class, (t_method)smerdyakov_clear,
         gensym("clear"), 0);
     class_addmethod(smerdyakov_class, (t_method)smerdyakov_record,
@@ -533,5 +568,7 @@ void smerdyakov_setup(void)
         gensym("read"), A_SYMBOL, 0);
     class_addmethod(smerdyakov_class, (t_method)smerdyakov_mix,
         gensym("mix"), A_DEFSYMBOL, A_DEFSYMBOL, A_DEFFLOAT, 0);
+    class_addmethod(smerdyakov_class, (t_method)smerdyakov_seed,
+        gensym("seed"), A_FLOAT, 0);
 }
 
@@ -1,50 +1,561 @@
 /* code for system pd class */
 
+/* Commands are run by a worker thread belonging to each object, so that
+Pd itself never waits for them.  The worker takes commands from a short
+queue, runs each one through /bin/sh with posix_spawn(), and passes back
+each line the command prints, and then its exit status, through a ring
+buffer which a clock empties.  Lines come out the left outlet as messages
+and exit statuses out the right one.
+
+Forking Pd itself can be slow when it's large (tables loaded, etc.) so
+objects made as "system -helper" instead pass their commands to a small
+shell started once, when the class is loaded, which runs them in turn and
+reports back on the same socket.  Commands from all such objects share the
+one helper and so are run one at a time. */
+
 #include "m_pd.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef NT
+#include <pthread.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+extern char **environ;
+#endif
 
 #ifdef NT
 #pragma warning(disable:4244)
 #endif
 
+#define SYSTEM_MAXJOBS 16       /* commands waiting to be run */
+#define SYSTEM_NRESULT 256      /* lines and statuses waiting to go out */
+#define SYSTEM_POLL 10          /* msec between checks for results */
+
+#ifndef NT
+typedef struct _sysresult
+{
+    char *r_line;               /* line of output, or 0 for exit status */
+    int r_status;
+} t_sysresult;
+
+typedef struct _sysreader
+{
+    int r_fd;
+    int r_n;                    /* bytes in buffer */
+    int r_pos;                  /* next byte to look at */
+    char r_buf[1024];
+} t_sysreader;
+
+typedef struct _sysworker
+{
+    pthread_mutex_t w_mutex;
+    pthread_cond_t w_cond;
+    char *w_jobs[SYSTEM_MAXJOBS];   /* commands to run, under the mutex */
+    int w_jobhead;
+    int w_jobtail;
+    int w_njobs;
+    volatile int w_quit;        /* set by Pd to stop the thread */
+    int w_refs;                 /* Pd and the thread; last one frees */
+    int w_usehelper;            /* run commands through the helper */
+        /* results are written only by the thread and read only by Pd,
+        so need no lock; each side only changes its own index. */
+    t_sysresult w_results[SYSTEM_NRESULT];
+    volatile int w_reshead;     /* next slot to write */
+    volatile int w_restail;     /* next slot to read */
+} t_sysworker;
+#endif
+
 typedef struct system
 {
     t_object x_ob;
+    t_outlet *x_lineout;
+    t_outlet *x_statusout;
+    t_clock *x_clock;
+    int x_pending;              /* commands whose status hasn't come back */
+#ifndef NT
+    t_sysworker *x_worker;
+#endif
 } t_system;
 
 t_class *system_class;
 
-static void *system_new(t_symbol *unused)
+#ifndef NT
+    /* called with the mutex locked; unlocks it, and frees everything if
+    the other side is already gone. */
+static void sysworker_release(t_sysworker *w)
 {
-    t_system *x = (t_system *)pd_new(system_class);
+    int refs = --w->w_refs;
+    pthread_mutex_unlock(&w->w_mutex);
+    if (!refs)
+    {
+        while (w->w_njobs)
+        {
+            free(w->w_jobs[w->w_jobtail]);
+            w->w_jobtail = (w->w_jobtail + 1) % SYSTEM_MAXJOBS;
+            w->w_njobs--;
+        }
+        while (w->w_restail != w->w_reshead)
+        {
+            if (w->w_results[w->w_restail].r_line)
+                free(w->w_results[w->w_restail].r_line);
+            w->w_restail = (w->w_restail + 1) % SYSTEM_NRESULT;
+        }
+        pthread_cond_destroy(&w->w_cond);
+        pthread_mutex_destroy(&w->w_mutex);
+        free(w);
+    }
+}
 
-    return (void *)x;
+    /* pass a line (or, if line is 0, the exit status) back to Pd.  If Pd
+    has fallen behind we wait for it here, in the worker thread. */
+static void sysworker_put(t_sysworker *w, char *line, int status)
+{
+    int head = w->w_reshead, next = (head + 1) % SYSTEM_NRESULT;
+    while (next == w->w_restail)
+    {
+        if (w->w_quit)
+        {
+            if (line)
+                free(line);
+            return;
+        }
+        usleep(1000);
+    }
+    w->w_results[head].r_line = line;
+    w->w_results[head].r_status = status;
+    __sync_synchronize();
+    w->w_reshead = next;
 }
 
-static void system_anything(t_system *x, t_symbol *s, int argc, t_atom *argv)
+    /* read a line (without the newline) into a new malloc()ed string,
+    or return 0 at end of file */
+static char *sysreader_getline(t_sysreader *r)
+{
+    char *line = 0;
+    int len = 0, size = 0;
+    while (1)
+    {
+        char c;
+        if (r->r_pos >= r->r_n)
+        {
+            int nread = read(r->r_fd, r->r_buf, sizeof(r->r_buf));
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread <= 0)
+            {
+                if (len)
+                {
+                    line[len] = 0;
+                    return (line);
+                }
+                if (line)
+                    free(line);
+                return (0);
+            }
+            r->r_n = nread;
+            r->r_pos = 0;
+        }
+        if (len + 1 >= size)
+        {
+            char *newline = realloc(line, (size = 2 * size + 64));
+            if (!newline)
+            {
+                if (line)
+                    free(line);
+                return (0);
+            }
+            line = newline;
+        }
+        if ((c = r->r_buf[r->r_pos++]) == '\n')
+        {
+            line[len] = 0;
+            return (line);
+        }
+        line[len++] = c;
+    }
+}
+
+    /* the helper: a shell reading one command per line, each preceded by
+    a tag, and running it in a subshell with stdin from /dev/null.  It
+    then writes a newline (to end any unfinished line of output) and a
+    status line starting with the tag.  The tag is made afresh for each
+    command, so that no line a command prints can be taken for its
+    status line, not even the status line of an earlier command. */
+static pthread_mutex_t syshelper_mutex = PTHREAD_MUTEX_INITIALIZER;
+static t_sysreader syshelper_reader;   /* r_fd is -1 if no helper */
+static unsigned int syshelper_seed;     /* for making tags */
+static unsigned int syshelper_count;
+
+static char syshelper_script[] =
+    "while IFS=' ' read -r tag cmd; do (eval \"$cmd\") </dev/null; "
+    "printf '\\n%s %d\\n' \"$tag\" $?; done";
+
+static void syshelper_start(void)
+{
+    int sv[2];
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+    char *argv[4];
+    argv[0] = "sh";
+    argv[1] = "-c";
+    argv[2] = syshelper_script;
+    argv[3] = 0;
+    syshelper_reader.r_fd = -1;
+    syshelper_reader.r_n = syshelper_reader.r_pos = 0;
+    syshelper_seed = (unsigned int)time(0) * 435898247 + getpid();
+    syshelper_count = 0;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    {
+        post("system: couldn't start helper");
+        return;
+    }
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], 0);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], 1);
+    if (posix_spawn(&pid, "/bin/sh", &actions, 0, argv, environ))
+    {
+        post("system: couldn't start helper");
+        close(sv[0]);
+    }
+    else syshelper_reader.r_fd = sv[0];
+    posix_spawn_file_actions_destroy(&actions);
+    close(sv[1]);
+}
+
+    /* give up on the helper; called with its mutex locked */
+static void syshelper_stop(void)
+{
+    close(syshelper_reader.r_fd);
+    syshelper_reader.r_fd = -1;
+    syshelper_reader.r_n = syshelper_reader.r_pos = 0;
+    syshelper_seed = (unsigned int)time(0) * 435898247 + getpid();
+    syshelper_count = 0;
+}
+
+    /* send all of buf to the helper, returning 0 on failure */
+static int syshelper_send(char *buf, int len)
+{
+    int sent, nsent;
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    for (sent = 0; sent < len; sent += nsent)
+        if ((nsent = send(syshelper_reader.r_fd, buf + sent, len - sent,
+            flags)) < 0)
+    {
+        if (errno != EINTR)
+            return (0);
+        nsent = 0;
+    }
+    return (1);
+}
+
+    /* run a command through the helper, returning 0 if there's no helper
+    (so the caller should run it itself) */
+static int syshelper_run(t_sysworker *w, char *cmd)
+{
+    char *line, *s, tag[32];
+    int len, taglen, ok, status = -1;
+    pthread_mutex_lock(&syshelper_mutex);
+    if (syshelper_reader.r_fd < 0)
+    {
+        pthread_mutex_unlock(&syshelper_mutex);
+        return (0);
+    }
+    syshelper_count++;
+    taglen = sprintf(tag, "%08x%08x ",
+        syshelper_seed ^ (syshelper_count * 2654435761u), syshelper_count);
+        /* the command has to fit on one line */
+    for (s = cmd; *s; s++)
+        if (*s == '\n')
+            *s = ' ';
+    *s = '\n';      /* just while sending */
+    len = s - cmd + 1;
+    ok = (syshelper_send(tag, taglen) && syshelper_send(cmd, len));
+    *s = 0;
+    if (!ok)
+    {
+        syshelper_stop();
+        pthread_mutex_unlock(&syshelper_mutex);
+        return (0);
+    }
+    while ((line = sysreader_getline(&syshelper_reader)))
+    {
+        if (!strncmp(line, tag, taglen))
+        {
+            status = atoi(line + taglen);
+            free(line);
+            break;
+        }
+        sysworker_put(w, line, 0);
+    }
+    if (!line)      /* helper died; the command may or may not have run */
+        syshelper_stop();
+    pthread_mutex_unlock(&syshelper_mutex);
+    sysworker_put(w, 0, status);
+    return (1);
+}
+
+static void sysworker_run(t_sysworker *w, char *cmd)
 {
-    char cmdbuf[1000];
-    char atombuf[1000];
-    int i;
-    strcpy(cmdbuf, s->s_name);
+    int fd[2], status = -1;
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+    char *argv[4];
+    if (w->w_usehelper && syshelper_run(w, cmd))
+        return;
+    argv[0] = "sh";
+    argv[1] = "-c";
+    argv[2] = cmd;
+    argv[3] = 0;
+    if (pipe(fd) < 0)
+    {
+        sysworker_put(w, 0, -1);
+        return;
+    }
+        /* keep other objects' children from inheriting our pipe */
+    fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fd[1], 1);
+    if (posix_spawn(&pid, "/bin/sh", &actions, 0, argv, environ))
+        pid = -1;
+    posix_spawn_file_actions_destroy(&actions);
+    close(fd[1]);
+    if (pid > 0)
+    {
+        int ret;
+        t_sysreader reader;
+        char *line;
+        reader.r_fd = fd[0];
+        reader.r_n = reader.r_pos = 0;
+        while ((line = sysreader_getline(&reader)))
+            sysworker_put(w, line, 0);
+        while ((ret = waitpid(pid, &status, 0)) < 0 && errno == EINTR)
+            ;
+        if (ret < 0)
+            status = -1;
+        else if (WIFEXITED(status))
+            status = WEXITSTATUS(status);
+        else if (WIFSIGNALED(status))
+            status = 128 + WTERMSIG(status);
+        else status = -1;
+    }
+    close(fd[0]);
+    sysworker_put(w, 0, status);
+}
+
+static void *sysworker_thread(void *z)
+{
+    t_sysworker *w = (t_sysworker *)z;
+    pthread_mutex_lock(&w->w_mutex);
+    while (1)
+    {
+        char *cmd;
+        while (!w->w_njobs && !w->w_quit)
+            pthread_cond_wait(&w->w_cond, &w->w_mutex);
+        if (w->w_quit)
+            break;
+        cmd = w->w_jobs[w->w_jobtail];
+        w->w_jobtail = (w->w_jobtail + 1) % SYSTEM_MAXJOBS;
+        w->w_njobs--;
+        pthread_mutex_unlock(&w->w_mutex);
+        sysworker_run(w, cmd);
+        free(cmd);
+        pthread_mutex_lock(&w->w_mutex);
+    }
+    sysworker_release(w);
+    return (0);
+}
+
+static t_sysworker *sysworker_new(void)
+{
+    t_sysworker *w = (t_sysworker *)calloc(1, sizeof(*w));
+    pthread_t thread;
+    pthread_attr_t attr;
+    if (!w)
+        return (0);
+    pthread_mutex_init(&w->w_mutex, 0);
+    pthread_cond_init(&w->w_cond, 0);
+    w->w_refs = 2;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, sysworker_thread, w))
+    {
+        pthread_cond_destroy(&w->w_cond);
+        pthread_mutex_destroy(&w->w_mutex);
+        free(w);
+        w = 0;
+    }
+    pthread_attr_destroy(&attr);
+    return (w);
+}
+#endif /* NT */
+
+static void system_outline(t_system *x, char *line)
+{
+    t_binbuf *b = binbuf_new();
+    int n;
+    t_atom *vec;
+    binbuf_text(b, line, strlen(line));
+    n = binbuf_getnatom(b);
+    vec = binbuf_getvec(b);
+    if (n && vec[0].a_type == A_SYMBOL)
+        outlet_anything(x->x_lineout, vec[0].a_w.w_symbol, n-1, vec+1);
+    else if (n)
+        outlet_list(x->x_lineout, &s_list, n, vec);
+    binbuf_free(b);
+}
+
+static void system_tick(t_system *x)
+{
+#ifndef NT
+    t_sysworker *w = x->x_worker;
+    while (w->w_restail != w->w_reshead)
+    {
+        t_sysresult r;
+        __sync_synchronize();
+        r = w->w_results[w->w_restail];
+        __sync_synchronize();
+        w->w_restail = (w->w_restail + 1) % SYSTEM_NRESULT;
+        if (r.r_line)
+        {
+            system_outline(x, r.r_line);
+            free(r.r_line);
+        }
+        else
+        {
+            x->x_pending--;
+            outlet_float(x->x_statusout, r.r_status);
+        }
+    }
+    if (x->x_pending > 0)
+        clock_delay(x->x_clock, SYSTEM_POLL);
+#endif
+}
+
+    /* make the command line, allocated with malloc() since it's freed in
+    the worker thread */
+static char *system_makecmd(t_symbol *s, int argc, t_atom *argv)
+{
+    char atombuf[MAXPDSTRING], *cmd;
+    int i, len = strlen(s->s_name);
+    if (!(cmd = malloc(len + 1)))
+        return (0);
+    strcpy(cmd, s->s_name);
     for (i = 0; i < argc; i++)
     {
-    	strcat(cmdbuf, " ");
-    	atom_string(&argv[i], atombuf, 1000);
-    	strcat(cmdbuf, atombuf);
+        int n;
+        char *newcmd;
+        atom_string(&argv[i], atombuf, MAXPDSTRING);
+        n = strlen(atombuf);
+        if (!(newcmd = realloc(cmd, len + n + 2)))
+        {
+            free(cmd);
+            return (0);
+        }
+        cmd = newcmd;
+        cmd[len++] = ' ';
+        strcpy(cmd + len, atombuf);
+        len += n;
     }
-    strcat(cmdbuf, "\n");
-    fprintf(stderr, "%s", cmdbuf);
-    system(cmdbuf);
-    fprintf(stderr, "done.");
+    return (cmd);
+}
+
+static void system_anything(t_system *x, t_symbol *s, int argc, t_atom *argv)
+{
+    char *cmd = system_makecmd(s, argc, argv);
+#ifndef NT
+    t_sysworker *w = x->x_worker;
+#endif
+    if (!cmd)
+    {
+        pd_error(x, "system: out of memory");
+        return;
+    }
+#ifdef NT
+    outlet_float(x->x_statusout, system(cmd));
+    free(cmd);
+#else
+    if (!w)
+    {
+        pd_error(x, "system: couldn't start worker thread");
+        free(cmd);
+        return;
+    }
+    pthread_mutex_lock(&w->w_mutex);
+    if (w->w_njobs >= SYSTEM_MAXJOBS)
+    {
+        pthread_mutex_unlock(&w->w_mutex);
+        pd_error(x, "system: too many commands waiting; dropped '%s'", cmd);
+        free(cmd);
+        return;
+    }
+    w->w_jobs[w->w_jobhead] = cmd;
+    w->w_jobhead = (w->w_jobhead + 1) % SYSTEM_MAXJOBS;
+    w->w_njobs++;
+    pthread_cond_signal(&w->w_cond);
+    pthread_mutex_unlock(&w->w_mutex);
+    if (!x->x_pending++)
+        clock_delay(x->x_clock, SYSTEM_POLL);
+#endif
+}
+
+static void *system_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_system *x = (t_system *)pd_new(system_class);
+    int usehelper = 0;
+    while (argc && argv->a_type == A_SYMBOL &&
+        !strcmp(argv->a_w.w_symbol->s_name, "-helper"))
+            usehelper = 1, argc--, argv++;
+    if (argc)
+        pd_error(x, "system: extra arguments ignored");
+    x->x_lineout = outlet_new(&x->x_ob, 0);
+    x->x_statusout = outlet_new(&x->x_ob, &s_float);
+    x->x_clock = clock_new(x, (t_method)system_tick);
+    x->x_pending = 0;
+#ifndef NT
+    if (!(x->x_worker = sysworker_new()))
+        pd_error(x, "system: couldn't start worker thread");
+    else x->x_worker->w_usehelper = usehelper;
+#endif
+    return (void *)x;
+}
+
+    /* the worker finishes whatever it's running (without waiting for us)
+    and then exits; anything left over is freed by whichever goes last */
+static void system_free(t_system *x)
+{
+#ifndef NT
+    t_sysworker *w = x->x_worker;
+    if (w)
+    {
+        pthread_mutex_lock(&w->w_mutex);
+        w->w_quit = 1;
+        pthread_cond_signal(&w->w_cond);
+        sysworker_release(w);
+    }
+#endif
+    clock_free(x->x_clock);
 }
 
 void system_setup(void)
 {
     post("system v0.1 msp");
     system_class = class_new(gensym("system"), (t_newmethod)system_new,
-    	0, sizeof(t_system), 0, 0);
+    	(t_method)system_free, sizeof(t_system), 0, A_GIMME, 0);
     class_addanything(system_class, system_anything);
+#ifndef NT
+    syshelper_start();
+#endif
 }
@@ -0,0 +1,154 @@
+/* Copyright (c) 2005 Miller Puckette.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* the inner loop of tabreadwrap4~, compiled once for each instruction set
+(see ../cpu/cpu.h).  For SSE4 and up it's written so that the compiler can
+vectorize it: the wraparounds are done by arithmetic on comparisons instead
+of by branches, and a chunk index past the end of the table reads the
+first chunk and multiplies the result by zero.  Without vectors that's
+slower than branching, so the baseline keeps the original loop.  Both
+compute the same thing, except that with the branchless one a table
+holding infinities or NaNs in its first chunk gives NaN past the end
+instead of zero.  The pointers are "restrict" since the compiler won't
+otherwise gather from the table; Pd may pass the same vector as an input
+and the output, but that's harmless here since each output sample depends
+only on the input samples at the same index. */
+
+#include "m_pd.h"
+#include "../cpu/cpu.h"
+
+#ifdef __SSE4_1__
+
+    /* "split" is a constant wherever this is expanded below, so that each
+    copy of the loop is free of branches */
+static inline void interp_loop(t_word *restrict buf, int wrap, int tablimit,
+    t_float *restrict in1, t_float *restrict in2, t_float *restrict in3,
+    t_float *restrict out, int n, int split)
+{
+    double fwrap = wrap;
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        double dfindex1 = in1[i];
+        double dfindex2 = in2[i];
+        int index1, index2, neg, inrange, step, ia, ib, ic, id;
+        float findex1, findex2, a, b, c, d, cminusb, f;
+
+            /* index1 is the wraparound index into table segments of
+            size "wrap", adjusted to the range 0-fwrap; fold the
+            rounding case of exactly fwrap back to zero. */
+        dfindex1 += 1024;
+        dfindex1 = fwrap * (dfindex1 - (int)dfindex1);
+        index1 = (int)dfindex1;
+        findex1 = dfindex1 - index1;
+        index1 -= wrap * (index1 >= wrap);
+
+            /* index2 selects a mixture between two consecutive chunks,
+            clipped below at zero.  In split mode its fractional part comes
+            in separately. */
+        if (split)
+            dfindex2 += in3[i];
+        neg = (dfindex2 < 0);
+        index2 = (int)dfindex2 * !neg;
+        findex2 = (dfindex2 - (int)dfindex2) * !neg;
+        index2 *= wrap;
+        inrange = (index2 < tablimit);
+        index2 *= inrange;
+            /* distance from the first chunk to the second, which wraps
+            around to the beginning after the last chunk */
+        step = wrap - tablimit * (index2 + wrap >= tablimit);
+
+        ib = index2 + index1;
+        ia = ib - 1 + wrap * (index1 == 0);
+        ic = ib + 1 - wrap * (index1 + 1 >= wrap);
+        id = ic + 1 - wrap * (ic - index2 + 1 >= wrap);
+        a = buf[ia].w_float +
+            findex2 * (buf[ia + step].w_float - buf[ia].w_float);
+        b = buf[ib].w_float +
+            findex2 * (buf[ib + step].w_float - buf[ib].w_float);
+        c = buf[ic].w_float +
+            findex2 * (buf[ic + step].w_float - buf[ic].w_float);
+        d = buf[id].w_float +
+            findex2 * (buf[id + step].w_float - buf[id].w_float);
+
+        cminusb = c-b;
+        f = b + findex1 * (
+            cminusb - 0.1666667f * (1.-findex1) * (
+                (d - a - 3.0f * cminusb) * findex1 + (d + 2.0f*a - 3.0f*b)
+            )
+        );
+        out[i] = f * inrange;
+    }
+}
+
+#else /* __SSE4_1__ */
+
+static inline void interp_loop(t_word *buf, int wrap, int tablimit,
+    t_float *in1, t_float *in2, t_float *in3, t_float *out, int n, int split)
+{
+    double fwrap = wrap;
+    t_word *wp1, *wp2;
+    int i;
+    for (i = 0; i < n; i++, out++)
+    {
+        double dfindex1 = *in1++;
+        double dfindex2 = *in2++;
+        int index1, index2, ia, ic, id;
+        float findex1, findex2, a, b, c,  d, cminusb;
+
+        dfindex1 += 1024;
+        dfindex1 = fwrap * (dfindex1 - (int)dfindex1);
+        index1 = (int)dfindex1;
+        findex1 = dfindex1 - index1;
+        if (index1 >= wrap)
+            index1 -= wrap;
+
+        if (split)
+            dfindex2 += *in3++;
+        if (dfindex2 < 0)
+            dfindex2 = 0;
+        index2 = (int)dfindex2;
+        findex2 = dfindex2 - index2;
+        index2 *= wrap;
+        if (index2 >= tablimit)
+        {
+            *out = 0;
+            continue;
+        }
+        wp1 = buf + index2;
+        index2 += wrap;
+        if (index2 >= tablimit)
+            index2 -= tablimit;
+        wp2 = buf + index2;
+
+        ia = (index1 ? index1 - 1 : wrap - 1);
+        if ((ic = index1 + 1) >= wrap)
+            ic -= wrap;
+        if ((id = ic + 1) >= wrap)
+            id -= wrap;
+        a = wp1[ia].w_float + findex2 * (wp2[ia].w_float - wp1[ia].w_float);
+        b = wp1[index1].w_float +
+            findex2 * (wp2[index1].w_float - wp1[index1].w_float);
+        c = wp1[ic].w_float + findex2 * (wp2[ic].w_float - wp1[ic].w_float);
+        d = wp1[id].w_float + findex2 * (wp2[id].w_float - wp1[id].w_float);
+
+        cminusb = c-b;
+        *out = b + findex1 * (
+            cminusb - 0.1666667f * (1.-findex1) * (
+                (d - a - 3.0f * cminusb) * findex1 + (d + 2.0f*a - 3.0f*b)
+            )
+        );
+    }
+}
+
+#endif /* __SSE4_1__ */
+
+void CPU_KERNEL(tabreadwrap4_interp)(t_word *restrict buf, int wrap,
+    int tablimit, t_float *restrict in1, t_float *restrict in2,
+    t_float *restrict in3, t_float *restrict out, int n)
+{
+    if (in3)
+        interp_loop(buf, wrap, tablimit, in1, in2, in3, out, n, 1);
+    else interp_loop(buf, wrap, tablimit, in1, in2, in3, out, n, 0);
+}
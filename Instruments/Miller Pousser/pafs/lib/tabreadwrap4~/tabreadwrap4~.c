@@ -6,6 +6,8 @@
 wraparound tables. */
 
 #include "m_pd.h"
+#include "../profile/profile.h"
+#include "../cpu/cpu.h"
 
 static t_class *tabreadwrap4_tilde_class;
 
@@ -17,8 +19,12 @@ typedef struct _tabreadwrap4_tilde
     t_symbol *x_arrayname;      /* name of array */
     float x_f;                  /* for signal inlet */
     int x_wrap;                 /* logical size of wraparound tables */
+    int x_split;                /* true if chunk index arrives in two parts */
+    PROFILE_FIELD
 } t_tabreadwrap4_tilde;
 
+    /* the wraparound size no longer has to be a power of two; neighboring
+    points are wrapped by comparison rather than masking. */
 void tabreadwrap4_tilde_wrap(t_tabreadwrap4_tilde *x, t_floatarg f)
 {
     int n = f;
@@ -26,150 +32,61 @@ void tabreadwrap4_tilde_wrap(t_tabreadwrap4_tilde *x, t_floatarg f)
         n = 1024;
     if (n < 4)
         pd_error(x, "tabreadwrap4~: correcting to minimum size 4"), n = 4;
-    if (n != (1 << ilog2(n)))
-        pd_error(x, "tabreadwrap4~: correcting to power of 2 size"),
-            n = ilog2(n);
     x->x_wrap = n;
 }
 
-static void *tabreadwrap4_tilde_new(t_symbol *s, t_floatarg f)
+    /* if the third argument is nonzero, a fourth (signal) inlet is added
+    whose value is added to the chunk index in double precision.  Send
+    the integer part of the chunk index to the second inlet and the
+    fractional part here, so that crossfades stay smooth far into long
+    multi-segment tables. */
+static void *tabreadwrap4_tilde_new(t_symbol *s, t_floatarg f,
+    t_floatarg split)
 {
     t_tabreadwrap4_tilde *x = (t_tabreadwrap4_tilde *)
         pd_new(tabreadwrap4_tilde_class);
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("wrap"));
+    if ((x->x_split = (split != 0)))
+        inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
     outlet_new(&x->x_obj, gensym("signal"));
     x->x_arrayname = s;
     x->x_vec = 0;
     x->x_f = 0;
     tabreadwrap4_tilde_wrap(x, f);
+    PROFILE_INIT(&x->x_profile, "perform");
     return (x);
 }
 
-#ifdef OPTIMIZE /* do this later... */
-#define UNITBIT32 1572864.  /* 3*2^19; bit 32 has place value 1 */
-
-#ifdef MSW
-    /* little-endian; most significant byte is at highest address */
-#define HIOFFSET 1
-#define LOWOFFSET 0
-#define int32 long
-#endif /* MSW */
-
-#ifdef __FreeBSD__
-#include <machine/endian.h>
-#endif
-
-#if defined(__linux__) || defined(MACOSX)
-#include <endian.h>
-#endif
-
-#ifdef __unix__
-#if BYTE_ORDER == LITTLE_ENDIAN
-#define HIOFFSET 1
-#define LOWOFFSET 0
-#else
-#define HIOFFSET 0    /* word offset to find MSB */
-#define LOWOFFSET 1    /* word offset to find LSB */
-#endif /* BYTE_ORDER */
-#include <sys/types.h>
-#define int32 int32_t
-#endif
-
-#if !defined(HIOFFSET)                       
-#error cannot determine machine byte order                                                   
-#endif                                                                          
-                                                                                
-union tabfudge
-{
-    double tf_d;
-    int32 tf_i[2];
-};
-#endif /* OPTIMIZE */
+    /* the inner loop, compiled for each instruction set in interp.c */
+typedef void t_interpfn(t_word *buf, int wrap, int tablimit,
+    t_float *in1, t_float *in2, t_float *in3, t_float *out, int n);
+CPU_DECLARE(t_interpfn, tabreadwrap4_interp);
+static t_interpfn *tabreadwrap4_tilde_interp;
 
 static t_int *tabreadwrap4_tilde_perform(t_int *w)
 {
     t_tabreadwrap4_tilde *x = (t_tabreadwrap4_tilde *)(w[1]);
     t_float *in1 = (t_float *)(w[2]);
     t_float *in2 = (t_float *)(w[3]);
-    t_float *out = (t_float *)(w[4]);
-    int n = (int)(w[5]);   
+    t_float *in3 = (t_float *)(w[4]);
+    t_float *out = (t_float *)(w[5]);
+    int n = (int)(w[6]);   
     int wrap = x->x_wrap; 
-    int npoints = x->x_npoints & (~(wrap-1));
-    t_word *buf = x->x_vec, *wp1, *wp2;
-    int i;
-    int normhipart;
-    int tablimit = ((int) (npoints / wrap)) * wrap;
+    t_word *buf = x->x_vec;
+    int tablimit = (x->x_npoints / wrap) * wrap;
+    PROFILE_BEGIN;
 
-    if (!buf)
+        /* without a whole chunk there's nothing to read */
+    if (!buf || tablimit <= 0)
     {
         while (n--)
             *out++ = 0;
-        goto done;
-    }
-#ifdef OPTIMIZE
-    tf.tf_d = UNITBIT32;
-    normhipart = tf.tf_i[HIOFFSET];
-    tf.tf_d = dphase;
-
-    ...
-#else
-    for (i = 0; i < n; i++, out++)
-    {
-        float findex1 = *in1++;
-        float findex2 = *in2++;
-        double dfindex;
-        int index1, index2, t;
-        float frac1, frac2, a, b, c,  d, cminusb, *fp1, *fp2, fwrap = wrap;
-        
-        /* index1 is the wraparound index into table segments of
-        size "wrap".  Only its fractional part matters; it is
-        adjusted to the range 0-fwrap. */
-        dfindex = 1024 + (double)findex1;
-        findex1 = fwrap * (dfindex - (int)dfindex);
-        
-        /* the integer part gives index into table segment, and fractional part is
-            is used for (4-point) interpolation */
-        index1 = (int)findex1;
-        findex1 -= index1;
-
-        /* index2 selects a mixture between two consecutive chunks. */
-        if (findex2 < 0)
-            findex2 = 0;
-        dfindex = (double)findex2;
-        index2 = (int)dfindex;
-        findex2 = dfindex - index2;
-        index2 *= wrap;
-        if (index2 >= tablimit)
-        {
-            *out = 0;
-            continue;
-        }        
-        wp1 = buf + index2;
-        index2 += wrap;
-        if (index2 >= tablimit)
-            index2 -= tablimit;
-        wp2 = buf + index2;
-        
-        t = (index1-1)&(wrap-1);
-        a = wp1[t].w_float + findex2 * (wp2[t].w_float - wp1[t].w_float);
-        t = (index1)&(wrap-1);
-        b = wp1[t].w_float + findex2 * (wp2[t].w_float - wp1[t].w_float);
-        t = (index1+1)&(wrap-1);
-        c = wp1[t].w_float + findex2 * (wp2[t].w_float - wp1[t].w_float);
-        t = (index1+2)&(wrap-1);
-        d = wp1[t].w_float + findex2 * (wp2[t].w_float - wp1[t].w_float);
-
-        cminusb = c-b;
-        *out = b + findex1 * (
-            cminusb - 0.1666667f * (1.-findex1) * (
-                (d - a - 3.0f * cminusb) * findex1 + (d + 2.0f*a - 3.0f*b)
-            )
-        );
     }
-#endif /* OPTIMIZE */
-done:
-    return (w+6);
+    else (*tabreadwrap4_tilde_interp)(buf, wrap, tablimit,
+        in1, in2, in3, out, n);
+    PROFILE_END(&x->x_profile, 0);
+    return (w+7);
 }
 
 void tabreadwrap4_tilde_set(t_tabreadwrap4_tilde *x, t_symbol *s)
@@ -195,16 +112,25 @@ static void tabreadwrap4_tilde_dsp(t_tabreadwrap4_tilde *x, t_signal **sp)
 {
     tabreadwrap4_tilde_set(x, x->x_arrayname);
 
-    dsp_add(tabreadwrap4_tilde_perform, 5, x,
-        sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[0]->s_n);
+    if (x->x_split)
+        dsp_add(tabreadwrap4_tilde_perform, 6, x,
+            sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec,
+                sp[0]->s_n);
+    else dsp_add(tabreadwrap4_tilde_perform, 6, x,
+        sp[0]->s_vec, sp[1]->s_vec, (t_float *)0, sp[2]->s_vec, sp[0]->s_n);
 
 }
 
+static void tabreadwrap4_tilde_stats(t_tabreadwrap4_tilde *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "tabreadwrap4~", s);
+}
+
 void tabreadwrap4_tilde_setup(void)
 {
     tabreadwrap4_tilde_class = class_new(gensym("tabreadwrap4~"),
         (t_newmethod)tabreadwrap4_tilde_new, 0,
-        sizeof(t_tabreadwrap4_tilde), 0, A_DEFSYM, A_DEFFLOAT, 0);
+        sizeof(t_tabreadwrap4_tilde), 0, A_DEFSYM, A_DEFFLOAT, A_DEFFLOAT, 0);
     CLASS_MAINSIGNALIN(tabreadwrap4_tilde_class, t_tabreadwrap4_tilde, x_f);
     class_addmethod(tabreadwrap4_tilde_class, (t_method)tabreadwrap4_tilde_dsp,
         gensym("dsp"), 0);
@@ -212,4 +138,7 @@ void tabreadwrap4_tilde_setup(void)
         gensym("set"), A_SYMBOL, 0);
     class_addmethod(tabreadwrap4_tilde_class, (t_method)tabreadwrap4_tilde_wrap,
         gensym("wrap"), A_FLOAT, 0);
+    class_addmethod(tabreadwrap4_tilde_class,
+        (t_method)tabreadwrap4_tilde_stats, gensym("stats"), A_DEFSYM, 0);
+    tabreadwrap4_tilde_interp = CPU_PICK(tabreadwrap4_interp);
 }
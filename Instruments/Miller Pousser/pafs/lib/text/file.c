@@ -22,17 +22,43 @@
 #include "m_pd.h"
 #include "g_canvas.h"
 #include "file.h"
+#include "../guibatch/guibatch.h"
+#include "../instance/instance.h"
 
 char *class_gethelpdir(t_class *c);
 
+/* proxies are found by their master's address, hashed into a fixed
+   table of buckets chained through f_next */
+#define KRZYSZFILE_HASHSIZE 1024
+#define KRZYSZFILE_HASH(master) \
+    ((((unsigned long)(master)) >> 4) & (KRZYSZFILE_HASHSIZE - 1))
+
 static t_class *krzyszfile_class = 0;
-static t_krzyszfile *krzyszfile_proxies;
-static t_symbol *ps__C;
+
+/* the proxies and the "#C" symbol belong to a Pd instance (see
+   ../instance/instance.h) */
+typedef struct _krzyszfilestate
+{
+    t_krzyszfile *s_proxies[KRZYSZFILE_HASHSIZE];
+    t_symbol *s__C;
+} t_krzyszfilestate;
+
+static t_instancekey krzyszfile_key = INSTANCE_KEY(t_krzyszfilestate);
+
+static t_krzyszfilestate *krzyszfile_getstate(void)
+{
+    t_krzyszfilestate *st =
+        (t_krzyszfilestate *)instance_get(&krzyszfile_key);
+    if (!st->s__C)
+        st->s__C = gensym("#C");
+    return (st);
+}
 
 static t_krzyszfile *krzyszfile_getproxy(t_pd *master)
 {
     t_krzyszfile *f;
-    for (f = krzyszfile_proxies; f; f = f->f_next)
+    for (f = krzyszfile_getstate()->s_proxies[KRZYSZFILE_HASH(master)]; f;
+         f = f->f_next)
         if (f->f_master == master)
             return (f);
     return (0);
@@ -42,13 +68,13 @@ static t_krzyszfile *krzyszfile_getproxy(t_pd *master)
 void krzyszeditor_open(t_krzyszfile *f, char *title)
 {
     if (!title) title = class_getname(*f->f_master);
-    sys_vgui("krzyszeditor_open .%x %dx%d {%s}\n", (unsigned long)f,
+    guibatch_add("krzyszeditor_open .%x %dx%d {%s}\n", (unsigned long)f,
         600, 340, title);
 }
 
 static void krzyszeditor_tick(t_krzyszfile *f)
 {
-    sys_vgui("krzyszeditor_close .%x %d\n", (unsigned long)f, 1);
+    guibatch_add("krzyszeditor_close .%x %d\n", (unsigned long)f, 1);
 }
 
 void krzyszeditor_close(t_krzyszfile *f, int ask)
@@ -58,13 +84,31 @@ void krzyszeditor_close(t_krzyszfile *f, int ask)
            a message box redraw to happen -- LATER investigate */
         clock_delay(f->f_editorclock, 0);
     else
-        sys_vgui("krzyszeditor_close .%x %d\n", (unsigned long)f, 0);
+        guibatch_add("krzyszeditor_close .%x %d\n", (unsigned long)f, 0);
 }
 
 void krzyszeditor_append(t_krzyszfile *f, char *contents)
 {
     if (!contents) contents = "";
-    sys_vgui("krzyszeditor_append .%x {%s}\n", (unsigned long)f, contents);
+    guibatch_add("krzyszeditor_append .%x {%s}\n", (unsigned long)f, contents);
+}
+
+    /* the whole text is in; the editor may send edits from now on */
+void krzyszeditor_loaded(t_krzyszfile *f)
+{
+    guibatch_add("krzyszeditor_loaded .%x\n", (unsigned long)f);
+}
+
+    /* the text changed since it was loaded or last saved */
+void krzyszeditor_stale(t_krzyszfile *f)
+{
+    guibatch_add("krzyszeditor_stale .%x\n", (unsigned long)f);
+}
+
+    /* ask for the whole text, when the last edit couldn't be placed */
+void krzyszeditor_resend(t_krzyszfile *f)
+{
+    guibatch_add("krzyszeditor_resend .%x\n", (unsigned long)f);
 }
 
 static void krzyszeditor_clear(t_krzyszfile *f)
@@ -76,6 +120,28 @@ static void krzyszeditor_clear(t_krzyszfile *f)
         else
             f->f_binbuf = binbuf_new();
     }
+    f->f_edithead = f->f_edittail = -1;
+}
+
+/* The editor only sends the lines it has changed, preceded by the number
+   of (semicolon-terminated) lines left alone at the top and bottom. */
+static void krzyszeditor_replace(t_krzyszfile *f, t_floatarg head,
+                                 t_floatarg tail)
+{
+    krzyszeditor_clear(f);
+    f->f_edithead = (head < 0 ? 0 : head);
+    f->f_edittail = (tail < 0 ? 0 : tail);
+}
+
+/* called by a master's updatefn: returns nonzero if the atoms it was given
+   only replace the lines between the first *headp and the last *tailp */
+int krzyszeditor_getrange(t_krzyszfile *f, int *headp, int *tailp)
+{
+    if (f->f_edithead < 0)
+        return (0);
+    *headp = f->f_edithead;
+    *tailp = f->f_edittail;
+    return (1);
 }
 
 static void krzyszeditor_addline(t_krzyszfile *f,
@@ -107,6 +173,7 @@ static void krzyszeditor_end(t_krzyszfile *f)
         (*f->f_editorfn)(f->f_master, 0, binbuf_getnatom(f->f_binbuf),
                          binbuf_getvec(f->f_binbuf));
         binbuf_clear(f->f_binbuf);
+        f->f_edithead = f->f_edittail = -1;
     }
 }
 
@@ -119,10 +186,10 @@ static void krzyszpanel_symbol(t_krzyszfile *f, t_symbol *s)
 static void krzyszpanel_tick(t_krzyszfile *f)
 {
     if (f->f_savepanel)
-        sys_vgui("krzyszpanel_open %s {%s}\n", f->f_bindname->s_name,
+        guibatch_add("krzyszpanel_open %s {%s}\n", f->f_bindname->s_name,
                  f->f_inidir->s_name);
     else
-        sys_vgui("krzyszpanel_save %s {%s} {%s}\n", f->f_bindname->s_name,
+        guibatch_add("krzyszpanel_save %s {%s} {%s}\n", f->f_bindname->s_name,
                  f->f_inidir->s_name, f->f_inifile->s_name);
 }
 
@@ -163,12 +230,13 @@ static void krzyszembed_gc(t_pd *x, t_symbol *s, int expected)
 
 static void krzyszembed_restore(t_pd *master)
 {
-    krzyszembed_gc(master, ps__C, 1);
+    krzyszembed_gc(master, krzyszfile_getstate()->s__C, 1);
 }
 
 void krzyszembed_save(t_gobj *master, t_binbuf *bb)
 {
     t_krzyszfile *f = krzyszfile_getproxy((t_pd *)master);
+    t_symbol *ps__C = krzyszfile_getstate()->s__C;
     t_text *t = (t_text *)master;
     binbuf_addv(bb, "ssii", &s__X, gensym("obj"),
                 (int)t->te_xpix, (int)t->te_ypix);
@@ -213,11 +281,12 @@ int krzyszfile_ispasting(t_krzyszfile *f)
 
 void krzyszfile_free(t_krzyszfile *f)
 {
+    t_krzyszfilestate *st = krzyszfile_getstate();
     t_krzyszfile *prev, *next;
     krzyszeditor_close(f, 0);
     if (f->f_embedfn)
         /* just in case of missing 'restore' */
-        krzyszembed_gc(f->f_master, ps__C, 0);
+        krzyszembed_gc(f->f_master, st->s__C, 0);
     if (f->f_savepanel)
     {
         pd_unbind((t_pd *)f->f_savepanel, f->f_savepanel->f_bindname);
@@ -226,14 +295,14 @@ void krzyszfile_free(t_krzyszfile *f)
     if (f->f_bindname) pd_unbind((t_pd *)f, f->f_bindname);
     if (f->f_panelclock) clock_free(f->f_panelclock);
     if (f->f_editorclock) clock_free(f->f_editorclock);
-    for (prev = 0, next = krzyszfile_proxies;
+    for (prev = 0, next = st->s_proxies[KRZYSZFILE_HASH(f->f_master)];
          next; prev = next, next = next->f_next)
         if (next == f)
             break;
     if (prev)
         prev->f_next = f->f_next;
-    else if (f == krzyszfile_proxies)
-        krzyszfile_proxies = f->f_next;
+    else if (f == st->s_proxies[KRZYSZFILE_HASH(f->f_master)])
+        st->s_proxies[KRZYSZFILE_HASH(f->f_master)] = f->f_next;
     pd_free((t_pd *)f);
 }
 
@@ -241,10 +310,12 @@ t_krzyszfile *krzyszfile_new(t_pd *master, t_krzyszembedfn embedfn,
                              t_krzyszfilefn readfn, t_krzyszfilefn writefn,
                              t_krzyszfilefn updatefn)
 {
+    t_krzyszfilestate *st = krzyszfile_getstate();
     t_krzyszfile *result = (t_krzyszfile *)pd_new(krzyszfile_class);
     result->f_master = master;
-    result->f_next = krzyszfile_proxies;
-    krzyszfile_proxies = result;
+    result->f_edithead = result->f_edittail = -1;
+    result->f_next = st->s_proxies[KRZYSZFILE_HASH(master)];
+    st->s_proxies[KRZYSZFILE_HASH(master)] = result;
     if (!(result->f_canvas = canvas_getcurrent()))
     {
         bug("krzyszfile_new: out of context");
@@ -255,9 +326,9 @@ t_krzyszfile *krzyszfile_new(t_pd *master, t_krzyszembedfn embedfn,
     if (result->f_embedfn = embedfn)
     {
         /* just in case of missing 'restore' */
-        krzyszembed_gc(master, ps__C, 0);
+        krzyszembed_gc(master, st->s__C, 0);
         if (krzyszfile_isloading(result) || krzyszfile_ispasting(result))
-            pd_bind(master, ps__C);
+            pd_bind(master, st->s__C);
     }
 
     /* 2. the panels */
@@ -307,13 +378,14 @@ void krzyszfile_setup(t_class *c, int embeddable)
     }
     if (!krzyszfile_class)
     {
-        ps__C = gensym("#C");
         krzyszfile_class = class_new(gensym("_krzyszfile"), 0, 0,
                                      sizeof(t_krzyszfile),
                                      CLASS_PD | CLASS_NOINLET, 0);
         class_addsymbol(krzyszfile_class, krzyszpanel_symbol);
         class_addmethod(krzyszfile_class, (t_method)krzyszeditor_clear,
                         gensym("clear"), 0);
+        class_addmethod(krzyszfile_class, (t_method)krzyszeditor_replace,
+                        gensym("replace"), A_FLOAT, A_FLOAT, 0);
         class_addmethod(krzyszfile_class, (t_method)krzyszeditor_addline,
                         gensym("addline"), A_GIMME, 0);
         class_addmethod(krzyszfile_class, (t_method)krzyszeditor_end,
@@ -22,6 +22,8 @@ typedef struct _krzyszfile
     t_binbuf            *f_binbuf;
     t_clock             *f_panelclock;
     t_clock             *f_editorclock;
+    int                  f_edithead;    /* lines kept at top, or -1 */
+    int                  f_edittail;    /* lines kept at bottom */
     struct _krzyszfile  *f_savepanel;
     struct _krzyszfile  *f_next;
 } t_krzyszfile;
@@ -29,6 +31,10 @@ typedef struct _krzyszfile
 void krzyszeditor_open(t_krzyszfile *f, char *title);
 void krzyszeditor_close(t_krzyszfile *f, int ask);
 void krzyszeditor_append(t_krzyszfile *f, char *contents);
+void krzyszeditor_loaded(t_krzyszfile *f);
+void krzyszeditor_stale(t_krzyszfile *f);
+void krzyszeditor_resend(t_krzyszfile *f);
+int krzyszeditor_getrange(t_krzyszfile *f, int *headp, int *tailp);
 void krzyszpanel_open(t_krzyszfile *f, t_symbol *inidir);
 void krzyszpanel_save(t_krzyszfile *f, t_symbol *inidir, t_symbol *inifile);
 int krzyszfile_ismapped(t_krzyszfile *f);
@@ -11,18 +11,62 @@
 
 #include "m_pd.h"
 #include "file.h"
+#include "../profile/profile.h"
 #include <string.h>
+#include <stdlib.h>
 #ifdef UNISTD
 #include <unistd.h>
 #endif
 #ifdef MSW
 #include <io.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #endif
 
+#define TXT_STREAMLINES 256     /* lines parsed at a time when streaming */
+#define TXT_CHUNKSIZE 1024      /* atoms per recording chunk */
+#define TXT_RECPREALLOC 16      /* chunks to preallocate for recording */
+#define TXT_EDITORBYTES 4096    /* text sent to the editor at a time */
+#define TXT_EDITORDELAY 1       /* msec between pieces sent to editor */
+
+    /* what the editor window holds */
+#define TXT_EDITORCLOSED 0      /* not open (as far as we know) */
+#define TXT_EDITORLOADING 1     /* still being sent the text */
+#define TXT_EDITORSYNCED 2      /* the text, as of the last save */
+#define TXT_EDITORSTALE 3       /* the text has changed since */
+
+    /* one entry per (semicolon-terminated) line of the binbuf */
+typedef struct _txtline
+{
+    int l_onset;                /* index of line's first atom */
+    double l_time;              /* time at which the line's contents fire */
+} t_txtline;
+
+    /* recorded atoms are kept in a chain of fixed-size chunks until
+    recording stops, so that recording never has to copy what it has
+    already stored. */
+typedef struct _txtchunk
+{
+    struct _txtchunk *c_next;
+    int c_n;                    /* number of atoms used */
+    t_atom c_vec[TXT_CHUNKSIZE];
+} t_txtchunk;
+
+    /* lines with float keys, sorted for "range" */
+typedef struct _txtkey
+{
+    t_float k_f;
+    int k_line;
+} t_txtkey;
+
 typedef struct _txt
 {
     t_object x_ob;
     t_outlet *x_bangout;
+    t_outlet *x_infoout;
     void *x_binbuf;
     int x_onset;                /* playback position */
     t_clock *x_clock;
@@ -30,12 +74,58 @@ typedef struct _txt
     double x_whenclockset;
     t_float x_clockdelay;
     int x_automatic;
+    int x_absolute;             /* true to schedule against an anchor time */
+    double x_scoretime;         /* accumulated delays played so far */
+    double x_anchortime;        /* logical time when we last anchored... */
+    double x_anchorscore;       /* ... and the score time at that point */
     t_symbol *x_dir;
     t_canvas *x_canvas;
     t_krzyszfile *x_krzyszfile;
+        /* line index, built lazily by txt_index() */
+    t_txtline *x_lines;
+    int x_nlines;               /* number of lines indexed so far */
+    int x_linealloc;            /* allocated size of x_lines */
+    int x_nindexed;             /* number of atoms scanned so far */
+    int x_scanstate;            /* scanner state: between lines, etc. */
+    double x_scantime;          /* accumulated delay at scan point */
+        /* streaming: the file is mapped and parsed a window at a time */
+    char *x_map;                /* mapped file, or 0 if not streaming */
+    size_t x_mapsize;           /* size of mapped file */
+    size_t x_mappos;            /* offset of first byte not yet parsed */
+    int x_mapcr;                /* true if newlines end messages */
+        /* recording */
+    int x_recording;            /* true if "add" is being timestamped */
+    double x_recstart;          /* logical time recording started */
+    double x_recsofar;          /* sum of delays recorded so far */
+    t_txtchunk *x_recchunks;    /* all chunks, used or not */
+    t_txtchunk *x_reccur;       /* chunk now being filled */
+        /* sending contents to the editor window */
+    t_clock *x_openclock;
+    int x_openonset;            /* next atom to send */
+    int x_openstate;            /* TXT_EDITORCLOSED, etc. */
+        /* index by first atom of each line, built lazily by txt_keyindex() */
+    int *x_keyhead;             /* first line in each hash bucket, or -1 */
+    int *x_keytail;             /* last line in each hash bucket */
+    int x_nbucket;              /* number of buckets (a power of 2) */
+    int *x_keynext;             /* next line in same bucket, or -1 */
+    int x_keynextalloc;         /* allocated size of x_keynext */
+    int x_nkeyed;               /* number of lines hashed so far */
+    t_txtkey *x_sorted;         /* float-keyed lines in order of key */
+    int x_nsorted;              /* number of entries in x_sorted */
+    int x_sortedalloc;          /* allocated size of x_sorted */
+    int x_sortedlines;          /* x_nlines when sorted, or -1 */
+    PROFILE_FIELD
 } t_txt;
 
+#define SCAN_NEWLINE 0          /* at start of a line */
+#define SCAN_NEWMESS 1          /* after a comma; no target yet */
+#define SCAN_INMESS 2           /* inside a message with a target */
+#define SCAN_INDELAY 3          /* inside a (float) delay */
+
 static void txt_tick(t_txt *x);
+static void txt_opentick(t_txt *x);
+static void txt_invalidate(t_txt *x);
+static void txt_editorchanged(t_txt *x, int appended);
 static void txt_hammerupdate(t_pd *z, t_symbol *s, int argc, t_atom *argv);
 
 static t_class *txt_class;
@@ -46,26 +136,533 @@ static void *txt_new( void)
     t_txt *x = (t_txt *)pd_new(txt_class);
     x->x_binbuf = binbuf_new();
     x->x_clock = clock_new(x, (t_method)txt_tick);
+    x->x_openclock = clock_new(x, (t_method)txt_opentick);
+    x->x_openonset = 0;
+    x->x_openstate = TXT_EDITORCLOSED;
     outlet_new(&x->x_ob, &s_list);
     x->x_bangout = outlet_new(&x->x_ob, &s_bang);
+    x->x_infoout = outlet_new(&x->x_ob, &s_float);
     x->x_onset = 0;
     x->x_tempo = 1;
     x->x_whenclockset = 0;
     x->x_clockdelay = 0;
     x->x_automatic = 0;
+    x->x_absolute = 0;
+    x->x_scoretime = x->x_anchorscore = 0;
+    x->x_anchortime = clock_getlogicaltime();
     x->x_canvas = canvas_getcurrent();
     x->x_krzyszfile = krzyszfile_new((t_pd *)x, 0, 0, 0, txt_hammerupdate);
+    x->x_lines = (t_txtline *)getbytes(0);
+    x->x_nlines = x->x_linealloc = 0;
+    x->x_nindexed = 0;
+    x->x_scanstate = SCAN_NEWLINE;
+    x->x_scantime = 0;
+    x->x_map = 0;
+    x->x_mapsize = x->x_mappos = 0;
+    x->x_mapcr = 0;
+    x->x_recording = 0;
+    x->x_recstart = x->x_recsofar = 0;
+    x->x_recchunks = x->x_reccur = 0;
+    x->x_keyhead = x->x_keytail = x->x_keynext = 0;
+    x->x_nbucket = x->x_keynextalloc = x->x_nkeyed = 0;
+    x->x_sorted = 0;
+    x->x_nsorted = x->x_sortedalloc = 0;
+    x->x_sortedlines = -1;
+    PROFILE_INIT(&x->x_profile, "next");
     return (x);
 }
 
+/* ------------------------- streaming -------------------------- */
+
+    /* parse the next TXT_STREAMLINES lines of a streamed file into the
+    binbuf, replacing what was there.  Windows always end on a message
+    boundary, so playback never sees a message split in two.  Returns
+    zero when the file is used up. */
+static int txt_refill(t_txt *x)
+{
+#ifndef MSW
+    char *start, *cp, *ep;
+    size_t size, pagesize;
+    int nlines = 0;
+    if (!x->x_map || x->x_mappos >= x->x_mapsize)
+        return (0);
+    start = cp = x->x_map + x->x_mappos;
+    ep = x->x_map + x->x_mapsize;
+    while (cp < ep)
+    {
+        char c = *cp++;
+        if (c == '\\')
+        {
+            if (cp < ep)
+                cp++;
+        }
+        else if ((c == ';' || (x->x_mapcr && c == '\n')) &&
+            ++nlines >= TXT_STREAMLINES)
+                break;
+    }
+    size = cp - start;
+    if (x->x_mapcr)
+    {
+            /* as in binbuf_read(), newlines become semicolons */
+        char *buf = getbytes(size), *bp;
+        memcpy(buf, start, size);
+        for (bp = buf; bp < buf + size; bp++)
+            if (*bp == '\n')
+                *bp = ';';
+        binbuf_text(x->x_binbuf, buf, size);
+        freebytes(buf, size);
+    }
+    else binbuf_text(x->x_binbuf, start, size);
+    x->x_mappos += size;
+        /* let the kernel drop the pages we've parsed past */
+    pagesize = sysconf(_SC_PAGESIZE);
+    if (x->x_mappos >= pagesize)
+        madvise(x->x_map, x->x_mappos - (x->x_mappos % pagesize),
+            MADV_DONTNEED);
+    x->x_onset = 0;
+    txt_invalidate(x);
+    return (1);
+#else
+    return (0);
+#endif
+}
+
+static void txt_unstream(t_txt *x)
+{
+#ifndef MSW
+    if (x->x_map)
+        munmap(x->x_map, x->x_mapsize);
+#endif
+    x->x_map = 0;
+    x->x_mapsize = x->x_mappos = 0;
+}
+
 static void txt_rewind(t_txt *x)
 {
     x->x_onset = 0;
     clock_unset(x->x_clock);
     x->x_whenclockset = 0;
+    if (x->x_map)
+    {
+        x->x_mappos = 0;
+        binbuf_clear(x->x_binbuf);
+        txt_invalidate(x);
+        txt_refill(x);
+    }
 }
 
-static void txt_donext(t_txt *x, int drop)
+/* ----------------------- absolute timing ------------------------ */
+
+    /* In absolute mode each delay is added (in double precision) to the
+    score time, and the clock is set from the anchor instead of from the
+    previous event, so that rounding errors can't accumulate.  Returns 0
+    without setting the clock if the event is already due. */
+static int txt_schedule(t_txt *x)
+{
+    double left = (x->x_scoretime - x->x_anchorscore) * x->x_tempo
+        - clock_gettimesince(x->x_anchortime);
+    if (left < 1e-6)
+        return (0);
+    clock_delay(x->x_clock, x->x_clockdelay = left);
+    x->x_whenclockset = clock_getsystime();
+    return (1);
+}
+
+    /* re-anchor at the current logical time: where are we in the score? */
+static void txt_anchor(t_txt *x)
+{
+    if (x->x_whenclockset != 0)
+    {
+        double left = x->x_clockdelay - clock_gettimesince(x->x_whenclockset);
+        x->x_anchorscore = x->x_scoretime - (left > 0 ? left : 0) / x->x_tempo;
+    }
+    else x->x_anchorscore = x->x_scoretime;
+    x->x_anchortime = clock_getlogicaltime();
+}
+
+static void txt_absolute(t_txt *x, t_floatarg f)
+{
+    if (f != 0 && !x->x_absolute)
+        txt_anchor(x);
+    x->x_absolute = (f != 0);
+}
+
+/* ------------------------- line index -------------------------- */
+
+    /* forget the index */
+static void txt_clearindex(t_txt *x)
+{
+    x->x_nlines = 0;
+    x->x_nindexed = 0;
+    x->x_scanstate = SCAN_NEWLINE;
+    x->x_scantime = 0;
+    x->x_nkeyed = 0;
+    x->x_sortedlines = -1;
+}
+
+    /* call this whenever atoms already in the binbuf change.  Appending
+    to the binbuf doesn't require it since the scan picks up where it left
+    off, but the editor has to hear of that too: see txt_editorchanged(). */
+static void txt_invalidate(t_txt *x)
+{
+    txt_clearindex(x);
+    txt_editorchanged(x, 0);
+}
+
+    /* make room for at least n lines in the index */
+static void txt_linereserve(t_txt *x, int n)
+{
+    if (n > x->x_linealloc)
+    {
+        int newalloc = 2 * x->x_linealloc + 64;
+        if (newalloc < n)
+            newalloc = n;
+        x->x_lines = (t_txtline *)resizebytes(x->x_lines,
+            x->x_linealloc * sizeof(t_txtline),
+                newalloc * sizeof(t_txtline));
+        x->x_linealloc = newalloc;
+        PROFILE_ALLOC(&x->x_profile);
+    }
+}
+
+    /* index the binbuf's atoms from where the last scan stopped up to
+    "argc".  The scan follows the same rules as txt_donext() for deciding
+    which floats are delays, so that each line's time is the logical time
+    its contents are sent. */
+static void txt_scan(t_txt *x, int argc)
+{
+    int i;
+    t_atom *argv = binbuf_getvec(x->x_binbuf), *ap;
+    int state = x->x_scanstate;
+    double time = x->x_scantime;
+    for (i = x->x_nindexed, ap = argv + i; i < argc; i++, ap++)
+    {
+            /* every semicolon ends a line, even an empty one, so that
+            line numbers agree with the editor's */
+        if (state == SCAN_NEWLINE)
+        {
+            txt_linereserve(x, x->x_nlines + 1);
+            x->x_lines[x->x_nlines].l_onset = i;
+            x->x_lines[x->x_nlines].l_time = time;
+            x->x_nlines++;
+            state = SCAN_NEWMESS;
+        }
+        if (ap->a_type == A_SEMI)
+        {
+            state = SCAN_NEWLINE;
+            continue;
+        }
+        else if (ap->a_type == A_COMMA)
+        {
+            if (state == SCAN_INDELAY)
+                state = SCAN_NEWMESS;
+            continue;
+        }
+        if (state == SCAN_NEWMESS)
+        {
+            if (ap->a_type == A_FLOAT)
+            {
+                if (ap->a_w.w_float > 0)
+                    time += ap->a_w.w_float;
+                    /* a delay at the head of the line postpones it */
+                if (x->x_lines[x->x_nlines-1].l_onset == i)
+                    x->x_lines[x->x_nlines-1].l_time = time;
+                state = SCAN_INDELAY;
+            }
+            else state = SCAN_INMESS;
+        }
+        else if (state == SCAN_INDELAY && ap->a_type != A_FLOAT)
+            state = SCAN_INMESS;
+    }
+    x->x_nindexed = argc;
+    x->x_scanstate = state;
+    x->x_scantime = time;
+}
+
+    /* bring the index up to date with the binbuf */
+static void txt_index(t_txt *x)
+{
+    txt_scan(x, binbuf_getnatom(x->x_binbuf));
+}
+
+    /* the accumulated delay at the start of line n, before any delay at
+    the head of the line itself; n may be x_nlines for the end of the
+    text.  The index must be up to date. */
+static double txt_linestart(t_txt *x, int n)
+{
+    t_atom *ap;
+    if (n >= x->x_nlines)
+        return (x->x_scantime);
+    ap = binbuf_getvec(x->x_binbuf) + x->x_lines[n].l_onset;
+    if (ap->a_type == A_FLOAT && ap->a_w.w_float > 0)
+        return (x->x_lines[n].l_time - ap->a_w.w_float);
+    else return (x->x_lines[n].l_time);
+}
+
+    /* go to the beginning of line n, counting from zero */
+static void txt_line(t_txt *x, t_floatarg f)
+{
+    int n = f;
+    txt_index(x);
+    clock_unset(x->x_clock);
+    x->x_whenclockset = 0;
+    if (n < 0)
+        n = 0;
+    x->x_onset = (n < x->x_nlines ? x->x_lines[n].l_onset :
+        binbuf_getnatom(x->x_binbuf));
+}
+
+    /* go to the first line sent at or after the given time.  If we're
+    playing automatically, playback continues from there, waiting only
+    for the part of that line's delay that falls after the seek time. */
+static void txt_seek(t_txt *x, t_floatarg f)
+{
+    int lo = 0, hi, onset, argc = binbuf_getnatom(x->x_binbuf);
+    t_atom *argv = binbuf_getvec(x->x_binbuf);
+    int playing = (x->x_automatic && x->x_whenclockset != 0);
+    txt_index(x);
+    hi = x->x_nlines;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) >> 1;
+        if (x->x_lines[mid].l_time < f)
+            lo = mid + 1;
+        else hi = mid;
+    }
+    clock_unset(x->x_clock);
+    x->x_whenclockset = 0;
+    if (lo >= x->x_nlines)
+    {
+        x->x_onset = argc;
+        return;
+    }
+    x->x_onset = onset = x->x_lines[lo].l_onset;
+    if (playing)
+    {
+        while (onset < argc && argv[onset].a_type == A_FLOAT)
+            onset++;
+        x->x_onset = onset;
+        x->x_scoretime = x->x_lines[lo].l_time;
+        if (x->x_absolute)
+        {
+            x->x_anchorscore = f;
+            x->x_anchortime = clock_getlogicaltime();
+            if (!txt_schedule(x))
+                clock_delay(x->x_clock, 0);
+        }
+        else
+        {
+            clock_delay(x->x_clock,
+                x->x_clockdelay = (x->x_lines[lo].l_time - f) * x->x_tempo);
+            x->x_whenclockset = clock_getsystime();
+        }
+    }
+}
+
+static void txt_count(t_txt *x)
+{
+    txt_index(x);
+    outlet_float(x->x_infoout, x->x_nlines);
+}
+
+/* ------------------------- key index -------------------------- */
+
+    /* the first atom of each line is its key.  Lines are hashed on it, and
+    lines in the same bucket are chained in order so that "findall" can
+    output them in the order they appear. */
+static unsigned int txt_keyhash(t_atom *ap)
+{
+    if (ap->a_type == A_SYMBOL)
+        return ((unsigned long)ap->a_w.w_symbol >> 3) * 2654435761u;
+    else
+    {
+        union
+        {
+            t_float u_f;
+            unsigned int u_i[sizeof(t_float) > sizeof(int) ? 2 : 1];
+        } u;
+        unsigned int h = 0, i;
+        u.u_i[sizeof(u.u_i)/sizeof(int) - 1] = 0;
+        u.u_f = (ap->a_w.w_float == 0 ? 0 : ap->a_w.w_float);
+        for (i = 0; i < sizeof(u.u_i)/sizeof(int); i++)
+            h ^= u.u_i[i];
+        return (h * 2654435761u);
+    }
+}
+
+static int txt_keymatch(t_atom *ap, t_atom *key)
+{
+    if (key->a_type == A_SYMBOL)
+        return (ap->a_type == A_SYMBOL &&
+            ap->a_w.w_symbol == key->a_w.w_symbol);
+    else return (ap->a_type == A_FLOAT &&
+        ap->a_w.w_float == key->a_w.w_float);
+}
+
+static t_atom *txt_linekey(t_txt *x, int line)
+{
+    t_atom *ap = binbuf_getvec(x->x_binbuf) + x->x_lines[line].l_onset;
+    return ((ap->a_type == A_SYMBOL || ap->a_type == A_FLOAT) ? ap : 0);
+}
+
+static void txt_keyindex(t_txt *x)
+{
+    int i;
+    txt_index(x);
+    if (x->x_nlines > x->x_keynextalloc)
+    {
+        int newalloc = x->x_linealloc;
+        x->x_keynext = (int *)resizebytes(x->x_keynext,
+            x->x_keynextalloc * sizeof(int), newalloc * sizeof(int));
+        x->x_keynextalloc = newalloc;
+    }
+        /* keep buckets at least twice as many as lines; rehash if not */
+    if (2 * x->x_nlines > x->x_nbucket)
+    {
+        int newsize = (x->x_nbucket ? x->x_nbucket : 64);
+        while (newsize < 2 * x->x_nlines)
+            newsize *= 2;
+        x->x_keyhead = (int *)resizebytes(x->x_keyhead,
+            x->x_nbucket * sizeof(int), newsize * sizeof(int));
+        x->x_keytail = (int *)resizebytes(x->x_keytail,
+            x->x_nbucket * sizeof(int), newsize * sizeof(int));
+        x->x_nbucket = newsize;
+        x->x_nkeyed = 0;
+    }
+    if (!x->x_nkeyed)
+        for (i = 0; i < x->x_nbucket; i++)
+            x->x_keyhead[i] = -1;
+    for (i = x->x_nkeyed; i < x->x_nlines; i++)
+    {
+        t_atom *key = txt_linekey(x, i);
+        x->x_keynext[i] = -1;
+        if (key)
+        {
+            int bucket = txt_keyhash(key) & (x->x_nbucket - 1);
+            if (x->x_keyhead[bucket] < 0)
+                x->x_keyhead[bucket] = i;
+            else x->x_keynext[x->x_keytail[bucket]] = i;
+            x->x_keytail[bucket] = i;
+        }
+    }
+    x->x_nkeyed = x->x_nlines;
+}
+
+    /* output the number of a line on the right, then the line itself.
+    Whatever gets the number may change the text, so the line is looked up
+    again afterward (and skipped if it's gone). */
+static void txt_outline(t_txt *x, int line)
+{
+    int argc, onset, onset2;
+    t_atom *argv, *ap;
+    outlet_float(x->x_infoout, line);
+    txt_index(x);
+    if (line >= x->x_nlines)
+        return;
+    argc = binbuf_getnatom(x->x_binbuf);
+    argv = binbuf_getvec(x->x_binbuf);
+    ap = argv + (onset = x->x_lines[line].l_onset);
+    for (onset2 = onset; onset2 < argc && argv[onset2].a_type != A_SEMI &&
+        argv[onset2].a_type != A_COMMA; onset2++)
+            ;
+    if (ap->a_type == A_SYMBOL)
+        outlet_anything(x->x_ob.ob_outlet, ap->a_w.w_symbol,
+            onset2-onset-1, ap+1);
+    else outlet_list(x->x_ob.ob_outlet, 0, onset2-onset, ap);
+}
+
+static void txt_dofind(t_txt *x, t_atom *key, int all)
+{
+    int line, found = 0;
+    if (key->a_type != A_SYMBOL && key->a_type != A_FLOAT)
+        return;
+    txt_keyindex(x);
+    if (!x->x_nbucket)
+        line = -1;
+    else line = x->x_keyhead[txt_keyhash(key) & (x->x_nbucket - 1)];
+        /* the checks against x_nkeyed guard against the text being
+        cleared by whatever we output to */
+    for (; line >= 0 && line < x->x_nkeyed; line = x->x_keynext[line])
+    {
+        if (txt_keymatch(txt_linekey(x, line), key))
+        {
+            found = 1;
+            txt_outline(x, line);
+            if (!all)
+                break;
+        }
+    }
+    if (!found)
+        outlet_float(x->x_infoout, -1);
+}
+
+    /* "find <key>" outputs the first line starting with key, and "findall"
+    all of them, each preceded by its line number on the right outlet.  If
+    there are none, -1 goes out the right outlet. */
+static void txt_find(t_txt *x, t_symbol *s, int argc, t_atom *argv)
+{
+    if (argc)
+        txt_dofind(x, argv, 0);
+}
+
+static void txt_findall(t_txt *x, t_symbol *s, int argc, t_atom *argv)
+{
+    if (argc)
+        txt_dofind(x, argv, 1);
+}
+
+static int txt_keycmp(const void *v1, const void *v2)
+{
+    const t_txtkey *k1 = (const t_txtkey *)v1, *k2 = (const t_txtkey *)v2;
+    if (k1->k_f < k2->k_f)
+        return (-1);
+    else if (k1->k_f > k2->k_f)
+        return (1);
+    else return (k1->k_line - k2->k_line);
+}
+
+    /* "range <from> <to>" outputs the lines whose (numeric) keys are
+    between from and to inclusive, in order of key. */
+static void txt_range(t_txt *x, t_floatarg from, t_floatarg to)
+{
+    int lo, hi, i;
+    txt_index(x);
+    if (x->x_sortedlines != x->x_nlines)
+    {
+        if (x->x_nlines > x->x_sortedalloc)
+        {
+            x->x_sorted = (t_txtkey *)resizebytes(x->x_sorted,
+                x->x_sortedalloc * sizeof(t_txtkey),
+                    x->x_linealloc * sizeof(t_txtkey));
+            x->x_sortedalloc = x->x_linealloc;
+        }
+        for (i = x->x_nsorted = 0; i < x->x_nlines; i++)
+        {
+            t_atom *key = txt_linekey(x, i);
+            if (key && key->a_type == A_FLOAT)
+            {
+                x->x_sorted[x->x_nsorted].k_f = key->a_w.w_float;
+                x->x_sorted[x->x_nsorted].k_line = i;
+                x->x_nsorted++;
+            }
+        }
+        qsort(x->x_sorted, x->x_nsorted, sizeof(t_txtkey), txt_keycmp);
+        x->x_sortedlines = x->x_nlines;
+    }
+    lo = 0, hi = x->x_nsorted;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) >> 1;
+        if (x->x_sorted[mid].k_f < from)
+            lo = mid + 1;
+        else hi = mid;
+    }
+    for (i = lo; i < x->x_nsorted && x->x_sortedlines >= 0 &&
+        x->x_sorted[i].k_f <= to; i++)
+        txt_outline(x, x->x_sorted[i].k_line);
+}
+
+static void txt_dodonext(t_txt *x, int drop)
 {
     t_pd *target = 0;
     while (1)
@@ -74,12 +671,12 @@ static void txt_donext(t_txt *x, int drop)
             count, onset = x->x_onset, onset2;
         t_atom *argv = binbuf_getvec(x->x_binbuf);
         t_atom *ap = argv + onset, *ap2;
-        if (onset >= argc) goto end;
+        if (onset >= argc) goto refill;
         while (ap->a_type == A_SEMI || ap->a_type == A_COMMA)
         {
             if (ap->a_type == A_SEMI) target = 0;
             onset++, ap++;
-            if (onset >= argc) goto end;
+            if (onset >= argc) goto refill;
         }
 
         if (!target && ap->a_type == A_FLOAT)
@@ -91,9 +688,21 @@ static void txt_donext(t_txt *x, int drop)
             x->x_onset = onset2;
             if (x->x_automatic)
             {
-                clock_delay(x->x_clock,
-                    x->x_clockdelay = ap->a_w.w_float * x->x_tempo);
-                x->x_whenclockset = clock_getsystime();
+                if (ap->a_w.w_float > 0)
+                    x->x_scoretime += ap->a_w.w_float;
+                    /* in absolute mode, go straight on to events that
+                    are due at the same logical time */
+                if (x->x_absolute)
+                {
+                    if (!txt_schedule(x))
+                        continue;
+                }
+                else
+                {
+                    clock_delay(x->x_clock,
+                        x->x_clockdelay = ap->a_w.w_float * x->x_tempo);
+                    x->x_whenclockset = clock_getsystime();
+                }
             }
             else outlet_list(x->x_ob.ob_outlet, 0, onset2-onset, ap);
             return;
@@ -130,6 +739,11 @@ static void txt_donext(t_txt *x, int drop)
             else if (ap->a_type == A_SYMBOL)
                 typedmess(target, ap->a_w.w_symbol, count-1, ap+1);
         }
+        continue;
+    refill:
+            /* windows end on semicolons so "target" is already clear */
+        if (!txt_refill(x))
+            goto end;
     }  /* while (1); never falls through */
 
 end:
@@ -137,6 +751,13 @@ end:
     x->x_whenclockset = 0;
 }
 
+static void txt_donext(t_txt *x, int drop)
+{
+    PROFILE_BEGIN;
+    txt_dodonext(x, drop);
+    PROFILE_END(&x->x_profile, 0);
+}
+
 static void txt_next(t_txt *x, t_floatarg drop)
 {
     x->x_automatic = 0;
@@ -146,6 +767,8 @@ static void txt_next(t_txt *x, t_floatarg drop)
 static void txt_start(t_txt *x)
 {
     txt_rewind(x);
+    x->x_scoretime = x->x_anchorscore = 0;
+    x->x_anchortime = clock_getlogicaltime();
     x->x_automatic = 1;
     txt_donext(x, 0);
 }
@@ -157,29 +780,177 @@ static void txt_tick(t_txt *x)
     txt_donext(x, 0);
 }
 
-static void txt_add(t_txt *x, t_symbol *s, int ac, t_atom *av)
+/* ------------------------- recording -------------------------- */
+
+    /* make sure there are at least n chunks, used or not */
+static void txt_recreserve(t_txt *x, int n)
+{
+    t_txtchunk **cp = &x->x_recchunks;
+    while (n-- > 0)
+    {
+        if (!*cp)
+        {
+            *cp = (t_txtchunk *)getbytes(sizeof(t_txtchunk));
+            (*cp)->c_next = 0;
+            (*cp)->c_n = 0;
+        }
+        cp = &(*cp)->c_next;
+    }
+    if (!x->x_reccur)
+        x->x_reccur = x->x_recchunks;
+}
+
+static void txt_recatom(t_txt *x, t_atom *ap)
+{
+    t_txtchunk *c = x->x_reccur;
+    if (c->c_n >= TXT_CHUNKSIZE)
+    {
+            /* only allocates if the preallocated chunks are used up */
+        if (!c->c_next)
+        {
+            c->c_next = (t_txtchunk *)getbytes(sizeof(t_txtchunk));
+            c->c_next->c_next = 0;
+            c->c_next->c_n = 0;
+            PROFILE_ALLOC(&x->x_profile);
+        }
+        c = x->x_reccur = c->c_next;
+    }
+    c->c_vec[c->c_n++] = *ap;
+}
+
+    /* store a message preceded by the time since the previous one, as
+    "start" expects.  The delay is taken from the start of recording less
+    the delays already stored so that rounding doesn't accumulate.  A
+    message starting with a number always gets a delay, even zero, or its
+    first number would be taken for one. */
+static void txt_recadd(t_txt *x, int ac, t_atom *av)
+{
+    double delay = clock_gettimesince(x->x_recstart) - x->x_recsofar;
+    t_atom a;
+    int i;
+    if (delay > 0 || (ac && av->a_type == A_FLOAT))
+    {
+        SETFLOAT(&a, (delay > 0 ? delay : 0));
+        x->x_recsofar += a.a_w.w_float;
+        txt_recatom(x, &a);
+    }
+    for (i = 0; i < ac; i++)
+        txt_recatom(x, av + i);
+    SETSEMI(&a);
+    txt_recatom(x, &a);
+}
+
+    /* copy what's been recorded onto the end of the binbuf */
+static void txt_recflush(t_txt *x)
+{
+    t_txtchunk *c;
+    for (c = x->x_recchunks; c; c = c->c_next)
+    {
+        binbuf_add(x->x_binbuf, c->c_n, c->c_vec);
+        if (c == x->x_reccur)
+            break;
+    }
+    txt_editorchanged(x, 1);
+    for (c = x->x_recchunks; c; c = c->c_next)
+        c->c_n = 0;
+    x->x_reccur = x->x_recchunks;
+}
+
+    /* "record 1" starts timestamping messages sent with "add"; an optional
+    second argument is the number of atoms to preallocate.  "record 0"
+    appends the result to the text. */
+static void txt_record(t_txt *x, t_floatarg f, t_floatarg reserve)
+{
+    if (f != 0)
+    {
+        int nchunks = (reserve > 0 ?
+            (reserve + (TXT_CHUNKSIZE - 1)) / TXT_CHUNKSIZE : TXT_RECPREALLOC);
+        txt_recreserve(x, nchunks);
+        if (!x->x_recording)
+        {
+            x->x_recstart = clock_getlogicaltime();
+            x->x_recsofar = 0;
+        }
+        x->x_recording = 1;
+    }
+    else if (x->x_recording)
+    {
+        x->x_recording = 0;
+        txt_recflush(x);
+    }
+}
+
+static void txt_recfree(t_txt *x)
+{
+    t_txtchunk *c, *next;
+    for (c = x->x_recchunks; c; c = next)
+    {
+        next = c->c_next;
+        freebytes(c, sizeof(t_txtchunk));
+    }
+    x->x_recchunks = x->x_reccur = 0;
+}
+
+static void txt_doadd(t_txt *x, int ac, t_atom *av)
 {
     t_atom a;
     SETSEMI(&a);
     binbuf_add(x->x_binbuf, ac, av);
     binbuf_add(x->x_binbuf, 1, &a);
+    txt_editorchanged(x, 1);
+}
+
+    /* the next window would overwrite anything added to a streamed text,
+    so adding is refused until the text is read or cleared instead */
+static int txt_streaming(t_txt *x)
+{
+    if (x->x_map)
+    {
+        pd_error(x, "text: can't add to a streamed file");
+        return (1);
+    }
+    return (0);
+}
+
+static void txt_add(t_txt *x, t_symbol *s, int ac, t_atom *av)
+{
+    if (txt_streaming(x))
+        return;
+    if (x->x_recording)
+        txt_recadd(x, ac, av);
+    else txt_doadd(x, ac, av);
 }
 
 static void txt_add2(t_txt *x, t_symbol *s, int ac, t_atom *av)
 {
+    if (txt_streaming(x))
+        return;
     binbuf_add(x->x_binbuf, ac, av);
+    txt_editorchanged(x, 1);
 }
 
 static void txt_clear(t_txt *x)
 {
+    txt_unstream(x);
     txt_rewind(x);
     binbuf_clear(x->x_binbuf);
+    txt_invalidate(x);
+    if (x->x_recording)
+    {
+            /* throw away what's been recorded and start over */
+        t_txtchunk *c;
+        for (c = x->x_recchunks; c; c = c->c_next)
+            c->c_n = 0;
+        x->x_reccur = x->x_recchunks;
+        x->x_recstart = clock_getlogicaltime();
+        x->x_recsofar = 0;
+    }
 }
 
 static void txt_set(t_txt *x, t_symbol *s, int ac, t_atom *av)
 {
     txt_clear(x);
-    txt_add(x, s, ac, av);
+    txt_doadd(x, ac, av);
 }
 
 static void txt_read(t_txt *x, t_symbol *filename, t_symbol *format)
@@ -190,11 +961,70 @@ static void txt_read(t_txt *x, t_symbol *filename, t_symbol *format)
     else if (*format->s_name)
         pd_error(x, "txt_read: unknown flag: %s", format->s_name);
 
+    txt_unstream(x);
     if (binbuf_read_via_canvas(x->x_binbuf, filename->s_name, x->x_canvas, cr))
             pd_error(x, "%s: read failed", filename->s_name);
+    txt_invalidate(x);
     txt_rewind(x);
 }
 
+    /* like "read", but map the file and parse it a window at a time as
+    playback reaches it, so that huge files start at once and take up
+    a fixed amount of memory.  "line", "seek", "count", "find", "findall"
+    and "range" then only see the TXT_STREAMLINES lines currently parsed,
+    numbered from the start of that window.  "add" is refused, and saving
+    from the editor ends streaming, so that what was edited becomes the
+    whole text. */
+static void txt_stream(t_txt *x, t_symbol *filename, t_symbol *format)
+{
+#ifndef MSW
+    int fd, cr = 0;
+    char buf[MAXPDSTRING], *bufptr;
+    struct stat statbuf;
+    void *map;
+    if (!strcmp(format->s_name, "cr"))
+        cr = 1;
+    else if (*format->s_name)
+        pd_error(x, "txt_stream: unknown flag: %s", format->s_name);
+    txt_unstream(x);
+    binbuf_clear(x->x_binbuf);
+    txt_invalidate(x);
+    if ((fd = open_via_path(canvas_getdir(x->x_canvas)->s_name,
+        filename->s_name, "", buf, &bufptr, MAXPDSTRING, 0)) < 0)
+    {
+        pd_error(x, "%s: can't open", filename->s_name);
+        txt_rewind(x);
+        return;
+    }
+    if (fstat(fd, &statbuf) < 0)
+    {
+        pd_error(x, "%s: can't get file size", filename->s_name);
+        close(fd);
+        txt_rewind(x);
+        return;
+    }
+    if (statbuf.st_size == 0 ||
+        (map = mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+            == MAP_FAILED)
+    {
+        if (statbuf.st_size != 0)
+            pd_error(x, "%s: can't map file", filename->s_name);
+        close(fd);
+        txt_rewind(x);
+        return;
+    }
+    close(fd);
+    madvise(map, statbuf.st_size, MADV_SEQUENTIAL);
+    x->x_map = map;
+    x->x_mapsize = statbuf.st_size;
+    x->x_mapcr = cr;
+    txt_rewind(x);
+#else
+    pd_error(x, "txt_stream: not available; reading whole file");
+    txt_read(x, filename, format);
+#endif
+}
+
 static void txt_write(t_txt *x, t_symbol *filename, t_symbol *format)
 {
     int cr = 0;
@@ -221,6 +1051,15 @@ static void txt_tempo(t_txt *x, t_float f)
     if (f < 1e-20) f = 1e-20;
     else if (f > 1e20) f = 1e20;
     newtempo = 1./f;
+        /* in absolute mode, re-anchor and reschedule from there */
+    if (x->x_absolute)
+    {
+        txt_anchor(x);
+        x->x_tempo = newtempo;
+        if (x->x_whenclockset != 0 && !txt_schedule(x))
+            clock_delay(x->x_clock, 0);
+        return;
+    }
     if (x->x_whenclockset != 0)
     {
         t_float elapsed = clock_gettimesince(x->x_whenclockset);
@@ -234,65 +1073,251 @@ static void txt_tempo(t_txt *x, t_float f)
 
 static void txt_bang(t_txt *x)
 {
-    int argc = binbuf_getnatom(x->x_binbuf),
-        count, onset = x->x_onset, onset2;
-    t_atom *argv = binbuf_getvec(x->x_binbuf);
-    t_atom *ap = argv + onset, *ap2;
-    while (onset < argc &&
-        (ap->a_type == A_SEMI || ap->a_type == A_COMMA))
-            onset++, ap++;
-    onset2 = onset;
-    ap2 = ap;
-    while (onset2 < argc &&
-        (ap2->a_type != A_SEMI && ap2->a_type != A_COMMA))
-            onset2++, ap2++;
-    if (onset2 > onset)
+    do
     {
-        x->x_onset = onset2;
-        if (ap->a_type == A_SYMBOL)
-            outlet_anything(x->x_ob.ob_outlet, ap->a_w.w_symbol,
-                onset2-onset-1, ap+1);
-        else outlet_list(x->x_ob.ob_outlet, 0, onset2-onset, ap);
+        int argc = binbuf_getnatom(x->x_binbuf),
+            onset = x->x_onset, onset2;
+        t_atom *argv = binbuf_getvec(x->x_binbuf);
+        t_atom *ap = argv + onset, *ap2;
+        while (onset < argc &&
+            (ap->a_type == A_SEMI || ap->a_type == A_COMMA))
+                onset++, ap++;
+        onset2 = onset;
+        ap2 = ap;
+        while (onset2 < argc &&
+            (ap2->a_type != A_SEMI && ap2->a_type != A_COMMA))
+                onset2++, ap2++;
+        if (onset2 > onset)
+        {
+            x->x_onset = onset2;
+            if (ap->a_type == A_SYMBOL)
+                outlet_anything(x->x_ob.ob_outlet, ap->a_w.w_symbol,
+                    onset2-onset-1, ap+1);
+            else outlet_list(x->x_ob.ob_outlet, 0, onset2-onset, ap);
+            return;
+        }
+    } while (txt_refill(x));
+    x->x_onset = 0x7fffffff;
+    outlet_bang(x->x_bangout);
+}
+
+/* interface with Hammer text editor */
+ 
+    /* send the next piece of the contents to the editor, formatted as
+    binbuf_gettext() would.  Pieces end on semicolons when possible and
+    are spread over scheduler ticks so that huge texts don't tie up Pd or
+    the GUI.  The editor hears when the last piece is in, and won't send
+    edits back before then. */
+static void txt_opentick(t_txt *x)
+{
+    int argc = binbuf_getnatom(x->x_binbuf), onset, length = 0;
+    t_atom *argv = binbuf_getvec(x->x_binbuf), *ap;
+    char buf[2*TXT_EDITORBYTES + MAXPDSTRING + 2];
+    if (!x->x_openonset)
+        krzyszeditor_open(x->x_krzyszfile, "Text");
+    for (onset = x->x_openonset, ap = argv + onset; onset < argc;
+        onset++, ap++)
+    {
+        if ((ap->a_type == A_SEMI || ap->a_type == A_COMMA) &&
+            length && buf[length-1] == ' ')
+                length--;
+        atom_string(ap, buf + length, MAXPDSTRING);
+        length += strlen(buf + length);
+        buf[length++] = (ap->a_type == A_SEMI ? '\n' : ' ');
+        if (length >= 2*TXT_EDITORBYTES ||
+            (length >= TXT_EDITORBYTES && ap->a_type == A_SEMI))
+        {
+            onset++;
+            break;
+        }
     }
+    if (onset >= argc && length && buf[length-1] == ' ')
+        length--;
+    buf[length] = 0;
+    krzyszeditor_append(x->x_krzyszfile, buf);
+    if ((x->x_openonset = onset) < argc)
+        clock_delay(x->x_openclock, TXT_EDITORDELAY);
     else
     {
-        x->x_onset = 0x7fffffff;
-        outlet_bang(x->x_bangout);
+        krzyszeditor_loaded(x->x_krzyszfile);
+        x->x_openstate = TXT_EDITORSYNCED;
+    }
+}
+
+    /* the binbuf changed behind the editor's back.  A load in progress
+    starts over unless the atoms were only appended (the next piece picks
+    them up); a loaded editor is told that line counts no longer match, so
+    that its next save sends the whole text. */
+static void txt_editorchanged(t_txt *x, int appended)
+{
+    if (x->x_openstate == TXT_EDITORLOADING && !appended)
+    {
+        x->x_openonset = 0;
+        clock_delay(x->x_openclock, TXT_EDITORDELAY);
+    }
+    else if (x->x_openstate == TXT_EDITORSYNCED)
+    {
+        krzyszeditor_stale(x->x_krzyszfile);
+        x->x_openstate = TXT_EDITORSTALE;
     }
 }
 
-/* interface with Hammer text editor */
- 
 static void txt_open(t_txt *x)
 {
-    char *buf;
-    int size;
-    krzyszeditor_open(x->x_krzyszfile, "Text");
-    binbuf_gettext(x->x_binbuf, &buf, &size);
-    buf = t_resizebytes(buf, size, size+1);
-    buf[size] = 0;
-    krzyszeditor_append(x->x_krzyszfile, buf);
-    t_freebytes(buf, size+1);
+    x->x_openonset = 0;
+    x->x_openstate = TXT_EDITORLOADING;
+    clock_unset(x->x_openclock);
+    txt_opentick(x);
 }
 
 static void txt_close(t_txt *x)
 {
+    clock_unset(x->x_openclock);
+    x->x_openstate = TXT_EDITORCLOSED;
     krzyszeditor_close(x->x_krzyszfile, 1);
 }
 
+    /* replace everything but the first "head" and last "tail" lines with
+    the editor's atoms.  If the size doesn't change this is done in place;
+    otherwise the pieces are copied into a new binbuf without reparsing.
+    The line index is kept: only the new lines are scanned, and the tail's
+    entries are moved along by the change in size and time.  The key index
+    is rebuilt the next time it's needed.  Either the text or the new
+    atoms may end in an unterminated line; if a tail follows, the new
+    atoms get the semicolon the editor's last line left off.  Returns 0,
+    leaving the text alone, if the lines can't be matched up. */
+static int txt_splice(t_txt *x, int head, int tail, int ac, t_atom *av)
+{
+    int argc = binbuf_getnatom(x->x_binbuf), start, end, nnew, i, delta,
+        endstate, needsemi;
+    t_atom *argv = binbuf_getvec(x->x_binbuf);
+    double starttime, endtime, textend, dtime;
+    txt_index(x);
+    if (head < 0 || tail < 0 || head + tail > x->x_nlines)
+        return (0);
+        /* the editor's head always ends in a semicolon */
+    if (head && head == x->x_nlines && x->x_scanstate != SCAN_NEWLINE)
+        return (0);
+    start = (head < x->x_nlines ? x->x_lines[head].l_onset : argc);
+    end = (tail ? x->x_lines[x->x_nlines - tail].l_onset : argc);
+    starttime = txt_linestart(x, head);
+    endtime = txt_linestart(x, x->x_nlines - tail);
+    textend = x->x_scantime;
+    endstate = x->x_scanstate;
+    needsemi = (tail && ac && av[ac-1].a_type != A_SEMI);
+    for (i = nnew = 0; i < ac; i++)
+        if (av[i].a_type == A_SEMI)
+            nnew++;
+    nnew += needsemi;
+    if (end - start == ac + needsemi)
+    {
+        memcpy(argv + start, av, ac * sizeof(t_atom));
+        if (needsemi)
+            SETSEMI(argv + start + ac);
+    }
+    else
+    {
+        t_binbuf *b = binbuf_new();
+        t_atom semi;
+        SETSEMI(&semi);
+        binbuf_add(b, start, argv);
+        binbuf_add(b, ac, av);
+        if (needsemi)
+            binbuf_add(b, 1, &semi);
+        binbuf_add(b, argc - end, argv + end);
+        binbuf_free(x->x_binbuf);
+        x->x_binbuf = b;
+    }
+    delta = ac + needsemi - (end - start);
+    x->x_nkeyed = 0;
+    x->x_sortedlines = -1;
+    if (!tail)
+    {
+            /* nothing follows; the scan leaves off where the text does */
+        x->x_nlines = head;
+        x->x_nindexed = start;
+        x->x_scanstate = SCAN_NEWLINE;
+        x->x_scantime = starttime;
+        txt_scan(x, argc + delta);
+        return (1);
+    }
+        /* move the tail's entries out of the way and scan the new lines
+        into the gap */
+    txt_linereserve(x, head + nnew + tail);
+    memmove(x->x_lines + head + nnew, x->x_lines + x->x_nlines - tail,
+        tail * sizeof(t_txtline));
+    x->x_nlines = head;
+    x->x_nindexed = start;
+    x->x_scanstate = SCAN_NEWLINE;
+    x->x_scantime = starttime;
+    txt_scan(x, start + ac + needsemi);
+    dtime = x->x_scantime - endtime;
+    for (i = head + nnew; i < head + nnew + tail; i++)
+    {
+        x->x_lines[i].l_onset += delta;
+        x->x_lines[i].l_time += dtime;
+    }
+    x->x_nlines = head + nnew + tail;
+    x->x_nindexed = argc + delta;
+    x->x_scanstate = endstate;
+    x->x_scantime = textend + dtime;
+    return (1);
+}
+
 static void txt_hammerupdate(t_pd *z, t_symbol *s, int argc, t_atom *argv)
 {
     t_txt *x = (t_txt *)z;
-    binbuf_clear(x->x_binbuf);
-    binbuf_add(x->x_binbuf, argc, argv);
+    int head, tail;
+    if (x->x_openstate == TXT_EDITORLOADING)
+    {
+            /* the editor waits for the last piece before saving, so this
+            is out of step; have it send everything once it's loaded */
+        krzyszeditor_resend(x->x_krzyszfile);
+        return;
+    }
+        /* the editor shows only the streamed window; keep what was saved
+        rather than letting txt_rewind() reparse the file over it */
+    txt_unstream(x);
+    if (!krzyszeditor_getrange(x->x_krzyszfile, &head, &tail))
+    {
+        binbuf_clear(x->x_binbuf);
+        binbuf_add(x->x_binbuf, argc, argv);
+        txt_clearindex(x);
+    }
+    else if (!txt_splice(x, head, tail, argc, argv))
+    {
+            /* never take a piece for the whole; ask for all of it */
+        pd_error(x, "text: editor out of step, resending whole text");
+        krzyszeditor_resend(x->x_krzyszfile);
+        return;
+    }
+    x->x_openstate = TXT_EDITORSYNCED;
     txt_rewind(x);
 }
 
+static void txt_stats(t_txt *x, t_symbol *s)
+{
+    PROFILE_STATS(&x->x_profile, "text", s);
+}
+
 static void txt_free(t_txt *x)
 {
     krzyszfile_free(x->x_krzyszfile);
+    txt_unstream(x);
+    txt_recfree(x);
     binbuf_free(x->x_binbuf);
+    freebytes(x->x_lines, x->x_linealloc * sizeof(t_txtline));
+    if (x->x_nbucket)
+    {
+        freebytes(x->x_keyhead, x->x_nbucket * sizeof(int));
+        freebytes(x->x_keytail, x->x_nbucket * sizeof(int));
+    }
+    if (x->x_keynextalloc)
+        freebytes(x->x_keynext, x->x_keynextalloc * sizeof(int));
+    if (x->x_sortedalloc)
+        freebytes(x->x_sorted, x->x_sortedalloc * sizeof(t_txtkey));
     if (x->x_clock) clock_free(x->x_clock);
+    clock_free(x->x_openclock);
 }
 
 /* ---------------- global setup function -------------------- */
@@ -316,17 +1341,36 @@ void text_setup(void )
         A_GIMME, 0);
     class_addmethod(txt_class, (t_method)txt_read, gensym("read"),
         A_SYMBOL, A_DEFSYM, 0);
+    class_addmethod(txt_class, (t_method)txt_stream, gensym("stream"),
+        A_SYMBOL, A_DEFSYM, 0);
     class_addmethod(txt_class, (t_method)txt_write, gensym("write"),
         A_SYMBOL, A_DEFSYM, 0);
     class_addmethod(txt_class, (t_method)txt_print, gensym("print"),
         A_DEFSYM, 0);
     class_addmethod(txt_class, (t_method)txt_start, gensym("start"), 0);
+    class_addmethod(txt_class, (t_method)txt_record,
+        gensym("record"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(txt_class, (t_method)txt_absolute,
+        gensym("absolute"), A_FLOAT, 0);
     class_addmethod(txt_class, (t_method)txt_tempo,
         gensym("tempo"), A_FLOAT, 0);
+    class_addmethod(txt_class, (t_method)txt_line,
+        gensym("line"), A_FLOAT, 0);
+    class_addmethod(txt_class, (t_method)txt_seek,
+        gensym("seek"), A_FLOAT, 0);
+    class_addmethod(txt_class, (t_method)txt_count, gensym("count"), 0);
+    class_addmethod(txt_class, (t_method)txt_find, gensym("find"),
+        A_GIMME, 0);
+    class_addmethod(txt_class, (t_method)txt_findall, gensym("findall"),
+        A_GIMME, 0);
+    class_addmethod(txt_class, (t_method)txt_range, gensym("range"),
+        A_FLOAT, A_FLOAT, 0);
     class_addbang(txt_class, txt_bang);
 
     class_addmethod(txt_class, (t_method)txt_open, gensym("open"), 0);
     class_addmethod(txt_class, (t_method)txt_close, gensym("close"), 0);
+    class_addmethod(txt_class, (t_method)txt_stats, gensym("stats"),
+        A_DEFSYM, 0);
     krzyszfile_setup(txt_class, 0);
 }
 